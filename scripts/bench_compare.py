@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Compare the results of two yane_bench runs.
+
+Usage: bench_compare.py BASELINE.json RESULTS.json
+
+Changes over the noise threshold are marked, the exit code is 1 when any
+result got slower. Only runs on the same machine compare.
+"""
+
+import json
+import sys
+
+NOISE_PERCENT = 5.0  # Smaller differences are not reported as changes
+
+
+def load(filename):
+    try:
+        with open(filename) as f:
+            data = json.load(f)
+        return data.get("host", ""), [(r["name"], r["unit"], float(r["value"])) for r in data["results"]]
+    except (OSError, ValueError, KeyError, TypeError) as e:
+        sys.exit("Error: Benchmark %s: %s" % (filename, e))
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__.strip())
+
+    baseline_host, baseline = load(sys.argv[1])
+    host, results = load(sys.argv[2])
+    expected = dict((name, value) for name, unit, value in baseline)
+
+    if baseline_host != host:
+        print("Warning: the baseline was taken on %s, results from other machines do not compare"
+              % (baseline_host or "an unknown host"))
+
+    print("Compared to %s, changes over %g%% are marked:" % (sys.argv[1], NOISE_PERCENT))
+    slower = faster = 0
+
+    for name, unit, value in results:
+        base = expected.get(name)
+
+        if base is None or base <= 0:
+            print("  %-36s  not in the baseline" % name)
+            continue
+
+        # Positive is worse: more time per operation or fewer frames per second
+        change = (value - base) / base * 100.0
+        worse = -change if unit == "fps" else change
+        line = "  %-36s%12.2f -> %12.2f %3s %+8.2f%%" % (name, base, value, unit, change)
+
+        if worse > NOISE_PERCENT:
+            line += "  slower"
+            slower += 1
+        elif worse < -NOISE_PERCENT:
+            line += "  faster"
+            faster += 1
+
+        print(line)
+
+    print("Benchmark: %d slower, %d faster than the baseline" % (slower, faster))
+    return 1 if slower else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,76 @@
+#include "band_workers.h"
+
+BandWorkers::BandWorkers(int threads)
+:
+  bands(threads < 1 ? 1 : threads),
+  job(NULL),
+  isRunning(true),
+  generation(0),
+  pending(0)
+{
+  for (int band = 1; band < bands; band++)
+  {
+    workers.push_back(std::thread(&BandWorkers::work, this, band));
+  }
+}
+
+BandWorkers::~BandWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(m);
+    isRunning = false;
+  }
+
+  wakeUp.notify_all();
+
+  for (std::thread &worker : workers)
+  {
+    worker.join();
+  }
+}
+
+// Returns once every band is done
+void BandWorkers::run(const std::function<void(int)> &job)
+{
+  {
+    std::lock_guard<std::mutex> lock(m);
+    this->job = &job;
+    pending = bands - 1;
+    generation++;
+  }
+
+  wakeUp.notify_all();
+  job(0);
+
+  std::unique_lock<std::mutex> lock(m);
+  done.wait(lock, [this]() { return pending == 0; });
+}
+
+void BandWorkers::work(int band)
+{
+  unsigned long long finished = 0;
+
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m);
+      wakeUp.wait(lock, [this, finished]() { return generation != finished || !isRunning; });
+
+      if (!isRunning)
+      {
+        break;
+      }
+
+      finished = generation;
+    }
+
+    (*job)(band);
+
+    {
+      std::lock_guard<std::mutex> lock(m);
+      pending--;
+    }
+
+    done.notify_one();
+  }
+}
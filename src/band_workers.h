@@ -0,0 +1,34 @@
+#ifndef _BAND_WORKERS_H_
+#define _BAND_WORKERS_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Runs a job split into bands, one per thread. The calling thread takes the
+// first band, persistent worker threads the rest.
+class BandWorkers
+{
+public:
+  BandWorkers(int threads);
+  ~BandWorkers();
+  int getBands() { return bands; };
+  void run(const std::function<void(int)> &job);
+
+private:
+  int bands;
+  const std::function<void(int)> *job;
+  std::vector<std::thread> workers;
+  std::mutex m;
+  std::condition_variable wakeUp;
+  std::condition_variable done;
+  bool isRunning;
+  unsigned long long generation;
+  int pending;
+
+  void work(int band);
+};
+
+#endif
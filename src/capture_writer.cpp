@@ -0,0 +1,135 @@
+#include <iostream>
+#include <string.h>
+#include <errno.h>
+#include <sstream>
+
+#include "capture_writer.h"
+#include "yane_exception.h"
+
+// NTSC frame rate, the master clock over 357366 clocks per frame (the odd
+// frames skip a dot)
+#define CAPTURE_RATE_NUMERATOR    39375000
+#define CAPTURE_RATE_DENOMINATOR  655171
+
+CaptureWriter::CaptureWriter(std::string filename, const palette_entry *colors, const overscan_crop &crop, unsigned int frameInterval)
+:
+  filename(filename),
+  converter(colors, PixelFormat::YUV420, crop),
+  frames(CAPTURE_BUFFERS * SCREEN_WIDTH * SCREEN_HEIGHT),
+  output(converter.getFrameSize()),
+  isRunning(false),
+  written(0),
+  dropped(0),
+  hasFailed(false)
+{
+  file.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+  if (!file.is_open())
+  {
+    throw CaptureException(filename, strerror(errno));
+  }
+
+  // Limited range BT.601 with chroma averaged over 2x2 pixels, and the NES
+  // pixel aspect ratio
+  std::stringstream header;
+  header << "YUV4MPEG2 W" << converter.getWidth() << " H" << converter.getHeight()
+    << " F" << CAPTURE_RATE_NUMERATOR << ":" << CAPTURE_RATE_DENOMINATOR * frameInterval
+    << " Ip A8:7 C420jpeg\n";
+  file << header.str();
+
+  for (int i = 0; i < CAPTURE_BUFFERS; i++)
+  {
+    spare.push(&frames[i * SCREEN_WIDTH * SCREEN_HEIGHT]);
+  }
+}
+
+CaptureWriter::~CaptureWriter()
+{
+  stop();
+}
+
+void CaptureWriter::start()
+{
+  isRunning = true;
+  t = std::thread(&CaptureWriter::run, this);
+}
+
+// Writes out the queued frames before returning
+void CaptureWriter::stop()
+{
+  if (!t.joinable())
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m);
+    isRunning = false;
+  }
+
+  wakeUp.notify_one();
+  t.join();
+  file.close();
+
+  std::cout << "Capture: " << written << " frames written to " << filename << ", " << dropped << " dropped" << std::endl;
+
+  if (hasFailed)
+  {
+    std::cerr << "Error: Writing " << filename << " failed, the capture is incomplete" << std::endl;
+  }
+}
+
+void CaptureWriter::submit(const unsigned short *frame)
+{
+  unsigned short *buffer;
+
+  if (!spare.pop(buffer))
+  {
+    dropped++;
+    return;
+  }
+
+  memcpy(buffer, frame, SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(unsigned short));
+  filled.push(buffer);
+
+  // Taking the lock orders the push before the writer's empty check, so
+  // the wake up can not be lost
+  {
+    std::lock_guard<std::mutex> lock(m);
+  }
+
+  wakeUp.notify_one();
+}
+
+void CaptureWriter::run()
+{
+  unsigned short *buffer;
+
+  while (true)
+  {
+    if (filled.pop(buffer))
+    {
+      converter.convert(buffer, output.data());
+      spare.push(buffer);
+
+      // Keep draining after a failure so the frame loop never runs dry
+      if (!hasFailed)
+      {
+        file << "FRAME\n";
+        file.write((const char*)output.data(), output.size());
+        hasFailed = !file.good();
+        written += hasFailed ? 0 : 1;
+      }
+
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m);
+    wakeUp.wait(lock, [this]() { return !filled.isEmpty() || !isRunning; });
+
+    if (!isRunning && filled.isEmpty())
+    {
+      break;
+    }
+  }
+}
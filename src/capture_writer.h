@@ -0,0 +1,47 @@
+#ifndef _CAPTURE_WRITER_H_
+#define _CAPTURE_WRITER_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "frame_converter.h"
+#include "spsc_queue.h"
+
+#define CAPTURE_BUFFERS  32  // Raw frames in flight, half a second at 60 Hz
+
+// Records frames to a Y4M file on its own thread. The frame loop only copies
+// the indexed frame into a free buffer and queues it; conversion and file
+// I/O happen on the writer thread. When the writer falls behind and no
+// buffer is free, the frame is dropped and counted instead of waiting.
+class CaptureWriter
+{
+public:
+  CaptureWriter(std::string filename, const palette_entry *colors, const overscan_crop &crop, unsigned int frameInterval);
+  ~CaptureWriter();
+  void start();
+  void stop();
+  void submit(const unsigned short *frame);
+
+private:
+  std::string filename;
+  std::ofstream file;
+  FrameConverter converter;
+  std::vector<unsigned short> frames;
+  std::vector<unsigned char> output;
+  SpscQueue<unsigned short*, CAPTURE_BUFFERS + 1> filled;  // Frame loop to writer
+  SpscQueue<unsigned short*, CAPTURE_BUFFERS + 1> spare;  // Writer back to frame loop
+  std::thread t;
+  std::mutex m;
+  std::condition_variable wakeUp;
+  bool isRunning;
+  unsigned long long written;
+  unsigned long long dropped;
+  bool hasFailed;
+
+  void run();
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <boost/assert.hpp>
 #include "cartridge.h"
 #include "ines.h"
+#include "stats.h"
 
 using namespace std;
 
@@ -11,7 +12,11 @@ Cartridge::Cartridge(boost::shared_ptr<iNes> rom)
   _rom(rom)
 {
   bzero(prgMap, sizeof(prgMap));
-  bzero(chrMap, sizeof(chrMap));
+
+  for (int i = 0; i < CHR_BANKS; i++)
+  {
+    chrPages[i] = _rom->getChrRomPage(0)->data;
+  }
 }
 
 bool Cartridge::readPrgRom(unsigned short address, unsigned char &value)
@@ -33,19 +38,34 @@ bool Cartridge::writePrgRom(unsigned short address, unsigned char value)
 bool Cartridge::readChrRom(unsigned short address, unsigned char &value)
 {
   size_t bankIndex = (address >> 10) & 0x0F;
-  BOOST_ASSERT_MSG(bankIndex < sizeof(chrMap), "Invalid CHR MAP address");
-  value = _rom->getChrRomPage(chrMap[bankIndex])->data[address & 0x03FF];
+  BOOST_ASSERT_MSG(bankIndex < CHR_BANKS, "Invalid CHR MAP address");
+  value = chrPages[bankIndex][address & 0x03FF];
   return true;
 }
 
 bool Cartridge::writeChrRom(unsigned short address, unsigned char value)
 {
   size_t bankIndex = (address >> 10) & 0x0F;
-  BOOST_ASSERT_MSG(bankIndex < sizeof(chrMap), "Invalid CHR MAP address");
-  _rom->getChrRomPage(chrMap[bankIndex])->data[address & 0x03FF] = value;
+  BOOST_ASSERT_MSG(bankIndex < CHR_BANKS, "Invalid CHR MAP address");
+  chrPages[bankIndex][address & 0x03FF] = value;
   return true;
 }
 
+// Bank mapping and mirroring, mappers with more registers add those
+void Cartridge::saveState(machine_state &state)
+{
+  std::vector<unsigned char> &registers = state.components[StateComponent::MapperRegisters];
+  registers.clear();
+  pushState(registers, prgMap, sizeof(prgMap));
+
+  for (int i = 0; i < CHR_BANKS; i++)
+  {
+    pushState(registers, (chrPages[i] - _rom->getChrRomPage(0)->data) / CHR_BANK_SIZE, 2);
+  }
+
+  pushState(registers, getMirroring(), 1);
+}
+
 void Cartridge::mapPrg(unsigned short address, unsigned char targetBankIndex, unsigned char banksToMap)
 {
   size_t bankIndex = (address >> 13) & 0x03;
@@ -53,6 +73,12 @@ void Cartridge::mapPrg(unsigned short address, unsigned char targetBankIndex, un
   for (int i = 0; i < banksToMap; i++)
   {
     BOOST_ASSERT_MSG(bankIndex < sizeof(prgMap), "Invalid PRG MAP address");
+
+    if (prgMap[bankIndex + i] != (unsigned char)(targetBankIndex + i))
+    {
+      STATS_INC(prgSwitches);
+    }
+
     prgMap[bankIndex + i] = targetBankIndex + i;
   }
 }
@@ -78,8 +104,15 @@ void Cartridge::mapChr(unsigned short address, unsigned char targetBankIndex, un
 
   for (int i = 0; i < banksToMap; i++)
   {
-    BOOST_ASSERT_MSG(bankIndex < sizeof(chrMap), "Invalid CHR MAP address");
-    chrMap[bankIndex + i] = targetBankIndex + i;
+    BOOST_ASSERT_MSG(bankIndex + i < CHR_BANKS, "Invalid CHR MAP address");
+    unsigned char *page = _rom->getChrRomPage((unsigned char)(targetBankIndex + i))->data;
+
+    if (chrPages[bankIndex + i] != page)
+    {
+      STATS_INC(chrSwitches);
+    }
+
+    chrPages[bankIndex + i] = page;
   }
 }
 
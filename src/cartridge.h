@@ -4,6 +4,7 @@
 #include <boost/shared_ptr.hpp>
 #include <strings.h>
 #include "ines.h"
+#include "machine_state.h"
 
 using namespace std;
 
@@ -18,11 +19,14 @@ public:
   virtual bool writePrgRom(unsigned short address, unsigned char value);
   virtual bool readChrRom(unsigned short address, unsigned char &value);
   virtual bool writeChrRom(unsigned short address, unsigned char value);
-  virtual void irqTick() {};
   virtual void reset() = 0;
   virtual enum Mirroring getMirroring() = 0;
   virtual string getName() = 0;
+  virtual void saveState(machine_state &state);
   const string toString();
+  unsigned char * const *getChrPageTable() { return chrPages; };
+  bool hasChrRam() { return _rom->hasChrRam(); };
+  unsigned char *getChrMemory() { return _rom->getChrRomPage(0)->data; };
 
 protected:
   boost::shared_ptr<iNes> _rom;
@@ -39,7 +43,7 @@ private:
   void mapPrg(unsigned short address, unsigned char targetBankIndex, unsigned char banksToMap);
   void mapChr(unsigned short address, unsigned char targetBankIndex, unsigned char banksToMap);
   unsigned char prgMap[PRG_BANKS];  // # 8 Kb pages => 4*8 Kb = 32 Kb PRG-ROM
-  unsigned char chrMap[CHR_BANKS];  // # 1 Kb pages => 1*8 Kb = 8 Kb CHR-ROM
+  unsigned char *chrPages[CHR_BANKS];  // Host pointers to mapped 1 Kb pages => 8*1 Kb = 8 Kb CHR-ROM
 };
 
 #endif
@@ -12,7 +12,9 @@
 
 boost::shared_ptr<Cartridge> CartridgeFactory::create(
   boost::shared_ptr<iNes> rom,
-  boost::shared_ptr<cpu> cpu)
+  boost::shared_ptr<cpu> cpu,
+  boost::shared_ptr<ppu> ppu,
+  boost::shared_ptr<Scheduler> scheduler)
 {
   int mapperId = rom->getMapperId();
 
@@ -35,7 +37,7 @@ boost::shared_ptr<Cartridge> CartridgeFactory::create(
       break;
 
     case 4:
-      return boost::make_shared<Mapper4>(rom, cpu);
+      return boost::make_shared<Mapper4>(rom, cpu, ppu, scheduler);
       break;
 
     case 7:
@@ -43,7 +45,7 @@ boost::shared_ptr<Cartridge> CartridgeFactory::create(
       break;
 
     case 9:
-      return boost::make_shared<Mapper9>(rom);
+      return boost::make_shared<Mapper9>(rom, ppu);
       break;
 
     case 66:
@@ -6,13 +6,17 @@
 #include <boost/shared_ptr.hpp>
 
 class cpu;
+class ppu;
+class Scheduler;
 
 class CartridgeFactory
 {
 public:
   static boost::shared_ptr<Cartridge> create(
     boost::shared_ptr<iNes> rom,
-    boost::shared_ptr<cpu> cpu);
+    boost::shared_ptr<cpu> cpu,
+    boost::shared_ptr<ppu> ppu,
+    boost::shared_ptr<Scheduler> scheduler);
 
 private:
   CartridgeFactory();
@@ -3,6 +3,8 @@
 
 #include <string>
 #include <boost/assert.hpp>
+#include "scaler.h"
+#include "frame_converter.h"
 
 #define YANE_VERSION_MAJOR   0
 #define YANE_VERSION_MINOR   6
@@ -25,7 +27,32 @@ public:
   bool isNesTest;
   bool isBlarghTest;
   bool isFullscreen;
+  bool ntscPalette;
+  bool ntscFilter;
+  double paletteHue;
+  double paletteSaturation;
+  unsigned int renderInterval;
+  bool renderThread;
+  unsigned int overscanTop;
+  unsigned int overscanBottom;
+  unsigned int overscanLeft;
+  unsigned int overscanRight;
+  enum ScaleFilter scaleFilter;
+  unsigned int scaleFactor;
+  unsigned int scaleThreads;
   std::string renderer;
+  std::string shmName;
+  unsigned int shmSlots;
+  enum PixelFormat shmFormat;
+  std::string captureVideo;
+  std::string stateLog;
+  std::string stateCompare;
+  unsigned long long stateDumpFrame;
+  unsigned long long frameLimit;
+  std::string recordMovie;
+  std::string playMovie;
+  std::string statsFile;
+  unsigned int statsInterval;
 
 private:
   Config() :
@@ -34,7 +61,32 @@ private:
     isNesTest(false),
     isBlarghTest(false),
     isFullscreen(false),
-    renderer("")
+    ntscPalette(false),
+    ntscFilter(false),
+    paletteHue(0.0),
+    paletteSaturation(1.0),
+    renderInterval(1),
+    renderThread(false),
+    overscanTop(0),
+    overscanBottom(0),
+    overscanLeft(8),
+    overscanRight(8),
+    scaleFilter(ScaleFilter::Nearest),
+    scaleFactor(0),
+    scaleThreads(0),
+    renderer(""),
+    shmName("/yane"),
+    shmSlots(4),
+    shmFormat(PixelFormat::XRGB8888),
+    captureVideo(""),
+    stateLog(""),
+    stateCompare(""),
+    stateDumpFrame(0),
+    frameLimit(0),
+    recordMovie(""),
+    playMovie(""),
+    statsFile(""),
+    statsInterval(60)
   {}
 
   ~Config() {}
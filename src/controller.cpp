@@ -12,6 +12,7 @@ Controller::~Controller() {}
 
 void Controller::stop()
 {
+  isRunning = false;
   t.join();
 }
 
@@ -15,6 +15,8 @@
 #include "config.h"
 #include "yane_exception.h"
 #include "utils.h"
+#include "scheduler.h"
+#include "stats.h"
 
 
 using namespace std;
@@ -61,6 +63,8 @@ unsigned short cpu::executeOpcode()
 
     if (interruptShouldExecute)
     {
+      STATS_INC(interrupts[interrupts.front()]);
+      STATS_ADD(cycles, INTERRUPT_CYCLES);
       reg_pc = executeInterrupt(interrupts.front());
       interrupts.pop_front();
 
@@ -128,6 +132,14 @@ unsigned short cpu::executeOpcode()
     reg_pc += entry.bytes;
   }
 
+  // Sprite DMA stalls the CPU, let the rest of the system see those cycles too.
+  // Same for polling iterations that were skipped.
+  cycles += dmaCycles + skippedCycles;
+  dmaCycles = 0;
+  skippedCycles = 0;
+
+  STATS_INC(instructions);
+  STATS_ADD(cycles, cycles);
   return cycles;
 }
 
@@ -146,6 +158,34 @@ void cpu::enqueueInterrupt(const enum Interrupt &interrupt)
   }
 }
 
+void cpu::saveState(machine_state &state)
+{
+  std::vector<unsigned char> &registers = state.components[StateComponent::CpuRegisters];
+  registers.clear();
+  pushState(registers, reg_pc, 2);
+  pushState(registers, reg_sp, 1);
+  pushState(registers, reg_acc, 1);
+  pushState(registers, reg_index_x, 1);
+  pushState(registers, reg_index_y, 1);
+  pushState(registers, reg_status, 1);
+
+  // Pending interrupts, then the controller ports
+  pushState(registers, interrupts.size(), 1);
+
+  for (std::list<Interrupt>::iterator it = interrupts.begin(); it != interrupts.end(); ++it)
+  {
+    pushState(registers, *it, 1);
+  }
+
+  // The buttons themselves are input, not state
+  pushState(registers, controllerStatus, 1);
+  pushState(registers, controllerLastWrite, 1);
+  pushState(registers, controllerReadCount, 2);
+
+  state.components[StateComponent::Ram].assign(memory, memory + INTERNAL_RAM_SIZE);
+  state.components[StateComponent::PrgRam].assign(memory + ADDR_PRG_RAM, memory + ADDR_PRG_RAM + PRG_RAM_SIZE);
+}
+
 void cpu::dequeueInterrupt()
 {
   if (interrupts.size() > 0)
@@ -159,9 +199,19 @@ cpu::cpu()
   _mapper = nullptr;
   _ppu = nullptr;
   _isInitialized = false;
+#ifdef YANE_FLAT_BUS
+  flatBus = NULL;
+#endif
+  dmaCycles = 0;
+  skippedCycles = 0;
+  pollTainted = true;
   controllerStatus = ControllerStatus::FirstWrite;
+  controllerLastWrite = 0;
   controllerReadCount[0] = 0;
   controllerReadCount[1] = 0;
+  frameInput[0] = 0;
+  frameInput[1] = 0;
+  isInputLatched = false;
 
   memory = new unsigned char[RAM_SIZE];
   memset(memory, 0, RAM_SIZE);
@@ -486,10 +536,12 @@ cpu::~cpu()
 
 void cpu::init(
   boost::shared_ptr<Cartridge> mapper,
-  boost::shared_ptr<ppu> ppu)
+  boost::shared_ptr<ppu> ppu,
+  boost::shared_ptr<Scheduler> scheduler)
 {
   _mapper = mapper;
   _ppu = ppu;
+  _scheduler = scheduler;
   _isInitialized = ppu ? true : false;
   _mapper->reset();
 }
@@ -523,6 +575,16 @@ unsigned char cpu::read(unsigned short address)
 {
   unsigned char value = 0;
 
+#ifdef YANE_FLAT_BUS
+  if (flatBus)
+  {
+    value = memory[address];
+    bus_access access = { address, value, false };
+    flatBus->push_back(access);
+    return value;
+  }
+#endif
+
   // Handle PRG-ROM reads
   if (address >= 0x8000 && address <= 0xFFFF)
   {
@@ -534,27 +596,37 @@ unsigned char cpu::read(unsigned short address)
 
   address = normalizeAddress(address);
 
+  if (address >= ADDR_PPU_CONTROL && address <= ADDR_PPU_DATA)
+  {
+    STATS_INC(ppuReads[address - ADDR_PPU_CONTROL]);
+  }
+
   switch (address)
   {
   case ADDR_PPU_STATUS:
     value = _ppu->readRegisterStatus();
+    skipStatusPolling(value);
     break;
 
   case ADDR_PPU_OAM_DATA:
 
     value = _ppu->readRegisterOAMData();
+    pollTainted = true;
     break;
 
   case ADDR_PPU_DATA:
     value = _ppu->readRegisterVRAMData();
+    pollTainted = true;
     break;
 
   case ADDR_INPUT_PORT_1:
     value = readController(address & 0x01);
+    pollTainted = true;
     break;
 
   case ADDR_INPUT_PORT_2:
     value = readController(address & 0x01);
+    pollTainted = true;
     break;
 
   default:
@@ -567,17 +639,39 @@ unsigned char cpu::read(unsigned short address)
 
 void cpu::write(unsigned short address, unsigned char value)
 {
-  // Handle PRG-ROM writes
+#ifdef YANE_FLAT_BUS
+  if (flatBus)
+  {
+    memory[address] = value;
+    bus_access access = { address, value, true };
+    flatBus->push_back(access);
+    return;
+  }
+#endif
+
+  pollTainted = true;
+
+  // Handle PRG-ROM writes. Mapper registers may switch CHR banks or
+  // mirroring, so let the PPU catch up first.
   if (address >= 0x8000 && address <= 0xFFFF)
   {
+    _ppu->catchUp();
+    STATS_INC(mapperWrites);
+
     if (_mapper->writePrgRom(address, value))
     {
+      _ppu->splitScanline();
       return;
     }
   }
 
   address = normalizeAddress(address);
 
+  if (address >= ADDR_PPU_CONTROL && address <= ADDR_PPU_DATA)
+  {
+    STATS_INC(ppuWrites[address - ADDR_PPU_CONTROL]);
+  }
+
   switch (address)
   {
   case ADDR_PPU_CONTROL:
@@ -610,6 +704,7 @@ void cpu::write(unsigned short address, unsigned char value)
 
   case ADDR_DMA:
     _ppu->writeDMA(value);
+    dmaCycles = DMA_CYCLES;
     break;
 
   case ADDR_INPUT_PORT_1:
@@ -632,6 +727,64 @@ void cpu::write(unsigned short address, unsigned char value)
   }
 }
 
+// A loop that reads $2002 from the same instruction with the same registers
+// and value, without writing or reading other I/O in between, keeps doing so
+// until the status changes. Fast forward whole iterations up to just before
+// that, or before the next scheduled event. Loops are assumed to wait on
+// VBlank or sprite 0 hit, the overflow flag is not predicted.
+void cpu::skipStatusPolling(unsigned char value)
+{
+  unsigned long long now = _scheduler->getCycles();
+
+  if (!pollTainted &&
+    !Config::instance().doInstructionLogging &&
+    interrupts.empty() &&
+    pollPc == reg_pc &&
+    pollValue == value &&
+    pollAcc == reg_acc &&
+    pollIndexX == reg_index_x &&
+    pollIndexY == reg_index_y &&
+    pollSp == reg_sp &&
+    pollStatus == reg_status &&
+    now > pollCycle)
+  {
+    unsigned long long period = now - pollCycle;
+    unsigned long long limit = _ppu->cyclesUntilStatusChange();
+    unsigned long long nextEvent = _scheduler->getNextCycle();
+
+    if (nextEvent <= now)
+    {
+      limit = 0;
+    }
+    else if (nextEvent - now < limit)
+    {
+      limit = nextEvent - now;
+    }
+
+    if (limit > IDLE_SKIP_MAX_CYCLES)
+    {
+      limit = IDLE_SKIP_MAX_CYCLES;
+    }
+
+    if (limit >= 2 * period)
+    {
+      skippedCycles = (limit / period - 1) * period;
+      now += skippedCycles;
+      STATS_ADD(pollCycles, skippedCycles);
+    }
+  }
+
+  pollTainted = false;
+  pollPc = reg_pc;
+  pollValue = value;
+  pollAcc = reg_acc;
+  pollIndexX = reg_index_x;
+  pollIndexY = reg_index_y;
+  pollSp = reg_sp;
+  pollStatus = reg_status;
+  pollCycle = now;
+}
+
 unsigned char cpu::readController(unsigned char id)
 {
   if (id == 0)
@@ -661,7 +814,7 @@ unsigned char cpu::readController(unsigned char id)
     }
     else
     {
-      unsigned char value = keyTable[controllerReadCount[id]].pressed;
+      unsigned char value = (frameInput[id] >> controllerReadCount[id]) & 0x01;
       controllerReadCount[id]++;
       return value | 0x40;
     }
@@ -693,7 +846,7 @@ unsigned char cpu::readController(unsigned char id)
     }
     else
     {
-      unsigned char value = 0;
+      unsigned char value = (frameInput[id] >> controllerReadCount[id]) & 0x01;
       controllerReadCount[id]++;
       return value | 0x40;
     }
@@ -712,11 +865,48 @@ void cpu::writeController(unsigned char controllerId, unsigned char value)
   {
     controllerReadCount[0] = 0;
     controllerReadCount[1] = 0;
+
+    if (!isInputLatched)
+    {
+      frameInput[0] = readKeyboard();
+      frameInput[1] = 0;
+      isInputLatched = true;
+    }
   }
 
   controllerLastWrite = value;
 }
 
+unsigned char cpu::readKeyboard()
+{
+  unsigned char buttons = 0;
+
+  for (unsigned int i = 0; i < keyTable.size(); i++)
+  {
+    buttons |= keyTable[i].pressed << i;
+  }
+
+  return buttons;
+}
+
+// The input of the current frame, sampling the keyboard if the game has not
+// strobed the controllers yet
+unsigned char cpu::getInput(unsigned char port)
+{
+  if (!isInputLatched)
+  {
+    return port == 0 ? readKeyboard() : 0;
+  }
+
+  return frameInput[port];
+}
+
+void cpu::setInput(unsigned char port, unsigned char buttons)
+{
+  frameInput[port] = buttons;
+  isInputLatched = true;
+}
+
 void cpu::updateControllerKeyStatus(SDL_Event event)
 {
   for (keyIterator = keyTable.begin(); keyIterator != keyTable.end(); keyIterator++)
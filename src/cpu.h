@@ -5,15 +5,21 @@
 #include <string>
 #include <map>
 #include <list>
+#include <vector>
 
 #include "ppu.h"
 #include "opcode_entry.h"
+#include "machine_state.h"
 
 class cpu;
 class Cartridge;
+class Scheduler;
 
 
 #define RAM_SIZE 65536
+#define INTERNAL_RAM_SIZE 0x0800
+#define ADDR_PRG_RAM 0x6000
+#define PRG_RAM_SIZE 0x2000
 #define STACK_LOWER 0x0100
 #define SP_INIT 0xFD
 #define STATUS_INIT 0x34
@@ -63,7 +69,10 @@ class Cartridge;
 #define DUMMY_ONCARRY      1
 #define DUMMY_ALWAYS      2
 
+#define CONTROLLER_PORTS    2
+
 #define INTERRUPT_CYCLES    7
+#define IDLE_SKIP_MAX_CYCLES  20000  // Keeps the cycles of one step within 16 bits
 
 
 enum ControllerStatus { FirstWrite, SecondWrite, Ready };
@@ -77,13 +86,23 @@ typedef struct
   bool pressed;
 } keyEntry;
 
+typedef struct
+{
+  unsigned short address;
+  unsigned char value;
+  bool isWrite;
+} bus_access;
+
 
 class cpu
 {
 public:
   cpu();
   ~cpu();
-  void init(boost::shared_ptr<Cartridge> mapper, boost::shared_ptr<ppu> ppu);
+  void init(
+    boost::shared_ptr<Cartridge> mapper,
+    boost::shared_ptr<ppu> ppu,
+    boost::shared_ptr<Scheduler> scheduler);
   bool isInitialized() { return _isInitialized; }
   void start();
   void stop();
@@ -94,10 +113,26 @@ public:
   void enqueueInterrupt(const enum Interrupt &interrupt);
   void dequeueInterrupt();
   void updateControllerKeyStatus(SDL_Event event);
+  void saveState(machine_state &state);
+
+  // Controller input is fixed per frame: the first strobe of a frame samples
+  // the keyboard, unless the input was set from outside, e.g. by a movie.
+  // Buttons are bits A, B, Select, Start, Up, Down, Left, Right from bit 0.
+  unsigned char getInput(unsigned char port);
+  void setInput(unsigned char port, unsigned char buttons);
+  void nextInputFrame() { isInputLatched = false; };
+
+#ifdef YANE_FLAT_BUS
+  // Without a mapper or PPU the whole address space is plain memory, and
+  // every access is appended to the list. Only the CPU harness is built
+  // with it, the emulator's bus accesses don't check for it.
+  void setFlatBus(std::vector<bus_access> *accesses) { flatBus = accesses; };
+#endif
 
 private:
   boost::shared_ptr<Cartridge> _mapper;
   boost::shared_ptr<ppu> _ppu;
+  boost::shared_ptr<Scheduler> _scheduler;
 
   bool is_running;
   bool isAborted;
@@ -113,8 +148,13 @@ private:
   enum ControllerStatus controllerStatus;
   unsigned char controllerLastWrite;
   unsigned char controllerReadCount[2];
+  unsigned char frameInput[CONTROLLER_PORTS];
+  bool isInputLatched;
 
   unsigned char *memory;
+#ifdef YANE_FLAT_BUS
+  std::vector<bus_access> *flatBus;
+#endif
   unsigned short reg_pc;
   unsigned char reg_sp;
   unsigned char reg_acc;
@@ -126,15 +166,30 @@ private:
 
   bool branchTaken;
   bool pageBoundaryCrossed;
+  unsigned short dmaCycles;
+  unsigned short skippedCycles;
+
+  // State at the last $2002 read, for finding polling loops
+  bool pollTainted;
+  unsigned short pollPc;
+  unsigned char pollValue;
+  unsigned char pollAcc;
+  unsigned char pollIndexX;
+  unsigned char pollIndexY;
+  unsigned char pollSp;
+  unsigned char pollStatus;
+  unsigned long long pollCycle;
   int opcodeHistory;
 
   void write(unsigned short address, unsigned char value);
   unsigned short normalizeAddress(unsigned short address);
   void log(opcode_entry *entry);
   unsigned short executeInterrupt(const enum Interrupt &interrupt);
+  void skipStatusPolling(unsigned char value);
 
   unsigned char readController(unsigned char controllerId);
   void writeController(unsigned char controllerId, unsigned char value);
+  unsigned char readKeyboard();
 
 
   inline void setPageBoundaryCrossed(unsigned short address1, unsigned short address2);
@@ -244,6 +299,8 @@ private:
 
   friend class Cartridge;
   friend class Mapper2;
+  friend class Benchmark;
+  friend class CpuHarness;
 };
 
 #endif
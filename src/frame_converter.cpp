@@ -0,0 +1,217 @@
+#include <boost/assert.hpp>
+
+// The gather kernels are built for AVX2 whatever the target of the rest of
+// the build, and only used when the CPU has it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRAME_CONVERTER_AVX2
+#include <immintrin.h>
+#endif
+
+#include "frame_converter.h"
+
+// BT.601 studio swing, 8 bit fixed point
+#define YUV_Y(r, g, b)  (16 + ((66 * (r) + 129 * (g) + 25 * (b) + 128) >> 8))
+#define YUV_U(r, g, b)  (128 + ((-38 * (r) - 74 * (g) + 112 * (b) + 128) >> 8))
+#define YUV_V(r, g, b)  (128 + ((112 * (r) - 94 * (g) - 18 * (b) + 128) >> 8))
+
+#ifdef FRAME_CONVERTER_AVX2
+// Gather 16 pixels, then pack them to 16 bits keeping their order. Returns
+// how many pixels of the row were converted, the scalar loop does the rest.
+__attribute__((target("avx2")))
+static int gatherRgb565(const unsigned int *table, const unsigned short *frame, unsigned short *row, int width)
+{
+  int x = 0;
+
+  for (; x + 16 <= width; x += 16)
+  {
+    __m256i indices = _mm256_loadu_si256((const __m256i*)(frame + x));
+    __m256i low = _mm256_i32gather_epi32((const int*)table, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(indices)), 4);
+    __m256i high = _mm256_i32gather_epi32((const int*)table, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(indices, 1)), 4);
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(low, high), 0xD8);
+    _mm256_storeu_si256((__m256i*)(row + x), packed);
+  }
+
+  return x;
+}
+
+__attribute__((target("avx2")))
+static int gatherXrgb8888(const unsigned int *table, const unsigned short *frame, unsigned int *row, int width)
+{
+  int x = 0;
+
+  for (; x + 8 <= width; x += 8)
+  {
+    __m256i indices = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(frame + x)));
+    _mm256_storeu_si256((__m256i*)(row + x), _mm256_i32gather_epi32((const int*)table, indices, 4));
+  }
+
+  return x;
+}
+#endif
+
+FrameConverter::FrameConverter(const palette_entry *colors, enum PixelFormat format, const overscan_crop &crop) :
+  format(format),
+  crop(crop),
+  width(SCREEN_WIDTH - crop.left - crop.right),
+  height(SCREEN_HEIGHT - crop.top - crop.bottom)
+{
+  BOOST_ASSERT_MSG(width > 0 && height > 0, "Overscan crop is larger than the frame");
+  setVectorized(true);
+
+  for (int i = 0; i < PALETTE_TABLE_SIZE; i++)
+  {
+    int r = colors[i].r, g = colors[i].g, b = colors[i].b;
+
+    if (format == PixelFormat::RGB565)
+    {
+      lut[i] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+    }
+    else
+    {
+      lut[i] = (r << 16) | (g << 8) | b;
+    }
+
+    lutYUV[i] = YUV_U(r, g, b) | (YUV_V(r, g, b) << 10) | (YUV_Y(r, g, b) << 24);
+  }
+}
+
+void FrameConverter::setVectorized(bool vectorized)
+{
+#ifdef FRAME_CONVERTER_AVX2
+  useAvx2 = vectorized && format != PixelFormat::YUV420 && __builtin_cpu_supports("avx2");
+#else
+  useAvx2 = false;
+#endif
+}
+
+int FrameConverter::getFrameSize()
+{
+  switch (format)
+  {
+  case PixelFormat::RGB565:
+    return width * height * 2;
+
+  case PixelFormat::XRGB8888:
+    return width * height * 4;
+
+  case PixelFormat::YUV420:
+    return width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2);
+  }
+
+  return 0;
+}
+
+void FrameConverter::convert(const unsigned short *frame, unsigned char *output, int pitch)
+{
+  frame += crop.top * SCREEN_WIDTH + crop.left;
+
+  switch (format)
+  {
+  case PixelFormat::RGB565:
+    convertRgb565(frame, output, pitch ? pitch : width * 2);
+    break;
+
+  case PixelFormat::XRGB8888:
+    convertXrgb8888(frame, output, pitch ? pitch : width * 4);
+    break;
+
+  case PixelFormat::YUV420:
+    convertYuv420(frame, output);
+    break;
+  }
+}
+
+// The loops work on locals, stores through the output could alias members
+
+void FrameConverter::convertRgb565(const unsigned short *frame, unsigned char *output, int pitch)
+{
+  const unsigned int *table = lut;
+  int rowWidth = width;
+  bool vectorized = useAvx2;
+
+  for (int y = height; y > 0; y--, frame += SCREEN_WIDTH, output += pitch)
+  {
+    unsigned short *row = (unsigned short*)output;
+    int x = 0;
+
+#ifdef FRAME_CONVERTER_AVX2
+    if (vectorized)
+    {
+      x = gatherRgb565(table, frame, row, rowWidth);
+    }
+#endif
+
+    for (; x < rowWidth; x++)
+    {
+      row[x] = table[frame[x]];
+    }
+  }
+}
+
+void FrameConverter::convertXrgb8888(const unsigned short *frame, unsigned char *output, int pitch)
+{
+  const unsigned int *table = lut;
+  int rowWidth = width;
+  bool vectorized = useAvx2;
+
+  for (int y = height; y > 0; y--, frame += SCREEN_WIDTH, output += pitch)
+  {
+    unsigned int *row = (unsigned int*)output;
+    int x = 0;
+
+#ifdef FRAME_CONVERTER_AVX2
+    if (vectorized)
+    {
+      x = gatherXrgb8888(table, frame, row, rowWidth);
+    }
+#endif
+
+    for (; x < rowWidth; x++)
+    {
+      row[x] = table[frame[x]];
+    }
+  }
+}
+
+// Two rows at a time, chroma is the average of each 2x2 block. Odd edges
+// repeat their last pixel.
+void FrameConverter::convertYuv420(const unsigned short *frame, unsigned char *output)
+{
+  const unsigned int *table = lutYUV;
+  int frameWidth = width;
+  int frameHeight = height;
+  int chromaWidth = (frameWidth + 1) / 2;
+  int chromaHeight = (frameHeight + 1) / 2;
+  unsigned char *planeY = output;
+  unsigned char *planeU = planeY + frameWidth * frameHeight;
+  unsigned char *planeV = planeU + chromaWidth * chromaHeight;
+
+  for (int y = 0; y < frameHeight; y += 2)
+  {
+    bool hasBottom = y + 1 < frameHeight;
+    const unsigned short *top = frame + y * SCREEN_WIDTH;
+    const unsigned short *bottom = hasBottom ? top + SCREEN_WIDTH : top;
+    unsigned char *topY = planeY + y * frameWidth;
+    unsigned char *bottomY = hasBottom ? topY + frameWidth : topY;
+    unsigned char *rowU = planeU + (y / 2) * chromaWidth;
+    unsigned char *rowV = planeV + (y / 2) * chromaWidth;
+
+    for (int x = 0; x < chromaWidth; x++)
+    {
+      int left = 2 * x;
+      int right = (left + 1 < frameWidth) ? left + 1 : left;
+      unsigned int topLeft = table[top[left]];
+      unsigned int topRight = table[top[right]];
+      unsigned int bottomLeft = table[bottom[left]];
+      unsigned int bottomRight = table[bottom[right]];
+      unsigned int sum = topLeft + topRight + bottomLeft + bottomRight + 0x802;
+
+      topY[left] = topLeft >> 24;
+      topY[right] = topRight >> 24;
+      bottomY[left] = bottomLeft >> 24;
+      bottomY[right] = bottomRight >> 24;
+      rowU[x] = (sum >> 2) & 0xFF;
+      rowV[x] = (sum >> 12) & 0xFF;
+    }
+  }
+}
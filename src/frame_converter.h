@@ -0,0 +1,52 @@
+#ifndef _FRAME_CONVERTER_H_
+#define _FRAME_CONVERTER_H_
+
+#include "ppu.h"
+
+enum PixelFormat { RGB565, XRGB8888, YUV420 };
+
+// Rows and columns cut from each edge of the frame
+typedef struct
+{
+  unsigned int top;
+  unsigned int bottom;
+  unsigned int left;
+  unsigned int right;
+} overscan_crop;
+
+// Converts the PPU's indexed frames to a pixel format through lookup tables
+// built once from the color table
+class FrameConverter
+{
+public:
+  FrameConverter(const palette_entry *colors, enum PixelFormat format, const overscan_crop &crop);
+
+  enum PixelFormat getFormat() { return format; };
+  int getWidth() { return width; };
+  int getHeight() { return height; };
+  int getFrameSize();
+
+  // The RGB formats use AVX2 gathers when the CPU has them, false forces the
+  // scalar loops
+  void setVectorized(bool vectorized);
+  bool isVectorized() { return useAvx2; };
+
+  // RGB rows are `pitch` bytes apart, or packed if it is 0. YUV420 is always
+  // written as packed Y, U and V planes, chroma rounded up to whole pixels.
+  void convert(const unsigned short *frame, unsigned char *output, int pitch = 0);
+
+private:
+  void convertRgb565(const unsigned short *frame, unsigned char *output, int pitch);
+  void convertXrgb8888(const unsigned short *frame, unsigned char *output, int pitch);
+  void convertYuv420(const unsigned short *frame, unsigned char *output);
+
+  enum PixelFormat format;
+  overscan_crop crop;
+  int width;
+  int height;
+  bool useAvx2;
+  unsigned int lut[PALETTE_TABLE_SIZE];  // Packed pixel per index, RGB565 is zero extended
+  unsigned int lutYUV[PALETTE_TABLE_SIZE];  // U in bits 0-9, V in bits 10-19 and Y in bits 24-31, so four can be summed at once
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <sstream>
 
 #include "ines.h"
+#include "utils.h"
 
 using namespace std;
 
@@ -11,6 +12,7 @@ iNes::iNes(const string _filename)
   filename = _filename;
   prgPageCount = 0;
   chrPageCount = 0;
+  dataHash = 0;
 }
 
 bool iNes::init()
@@ -59,6 +61,13 @@ bool iNes::init()
 
     file.close();
 
+    dataHash = utils::hash64((const unsigned char*)prgPages, prgPageCount * sizeof(prgRomPage));
+
+    if (!hasChrRam())
+    {
+      dataHash = utils::hash64((const unsigned char*)chrPages, chrPageCount * sizeof(chrRomPage), dataHash);
+    }
+
     _isValid = true;
   }
   else
@@ -117,6 +126,11 @@ bool iNes::hasFourScreenMirroring()
   return header.controlByte1 & 0x8;
 }
 
+bool iNes::hasChrRam()
+{
+  return header.chrRomPageCount == 0;
+}
+
 prgRomPage* iNes::getPrgRomPage(int page)
 {
   return &prgPages[page];
@@ -63,8 +63,10 @@ public:
   bool hasSRAM();
   bool hasTrainer();
   bool hasFourScreenMirroring();
+  bool hasChrRam();
   prgRomPage* getPrgRomPage(int page);
   chrRomPage* getChrRomPage(int page);
+  unsigned long long getDataHash() { return dataHash; };  // PRG and CHR ROM as loaded, the header is left out
 
 private:
   const std::string getPreamble();
@@ -76,6 +78,7 @@ private:
   int chrPageCount;
   prgRomPage* prgPages;
   chrRomPage* chrPages;
+  unsigned long long dataHash;
 };
 
 #endif
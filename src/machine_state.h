@@ -0,0 +1,32 @@
+#ifndef _MACHINE_STATE_H_
+#define _MACHINE_STATE_H_
+
+#include <vector>
+
+enum StateComponent { CpuRegisters, Ram, PrgRam, PpuRegisters, Vram, Oam, Palette, MapperRegisters, StateComponentCount };
+
+// Emulated state in a form that does not depend on how the emulator keeps it
+// internally, so it can be compared between builds. Lazily updated parts are
+// brought up to date first.
+typedef struct
+{
+  std::vector<unsigned char> components[StateComponentCount];
+} machine_state;
+
+static const char * const stateComponentNames[StateComponentCount] = { "cpu", "ram", "prgram", "ppu", "vram", "oam", "palette", "mapper" };
+
+// Values are stored little endian, `bytes` wide
+inline void pushState(std::vector<unsigned char> &state, unsigned long long value, int bytes)
+{
+  for (int i = 0; i < bytes; i++)
+  {
+    state.push_back((value >> (i * 8)) & 0xFF);
+  }
+}
+
+inline void pushState(std::vector<unsigned char> &state, const unsigned char *data, int size)
+{
+  state.insert(state.end(), data, data + size);
+}
+
+#endif
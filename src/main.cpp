@@ -4,14 +4,27 @@
 #include <SDL/SDL.h>
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "config.h"
 #include "yane.h"
+#include "ppu.h"
 #include "yane_exception.h"
 
 
 using namespace std;
 
+static Yane *yaneInstance = NULL;
+
+// Shut down cleanly on Ctrl-C too, renderers may have resources to release
+static void handleSignal(int signal)
+{
+  if (yaneInstance)
+  {
+    yaneInstance->stop();
+  }
+}
+
 int main(int argc, char **argv)
 {
   atexit(SDL_Quit);
@@ -27,7 +40,29 @@ int main(int argc, char **argv)
     ("log", "Enable logging of instructions (nestest format)")
     ("rom-info", "Display rom headers")
     ("fullscreen,f", "Use fullscreen mode")
-    ("renderer,r", boost::program_options::value<string>()->default_value("sdl"), "Use another render engine (default: SDL)")
+    ("renderer,r", boost::program_options::value<string>()->default_value("sdl"), "Use another render engine: sdl, shm, null (default: SDL)")
+    ("shm-name", boost::program_options::value<string>()->default_value("/yane"), "Shared memory object the shm renderer publishes frames to")
+    ("shm-slots", boost::program_options::value<unsigned int>()->default_value(4), "Frames the shm renderer keeps for readers")
+    ("shm-format", boost::program_options::value<string>()->default_value("xrgb8888"), "Pixel format of the shm renderer: xrgb8888, rgb565, yuv420")
+    ("capture-video", boost::program_options::value<string>(), "Record the drawn frames to a Y4M file")
+    ("state-log", boost::program_options::value<string>(), "Write a hash of the emulated state after every frame to a file")
+    ("state-compare", boost::program_options::value<string>(), "Compare the state after every frame to a state log, stop at the first difference")
+    ("state-dump", boost::program_options::value<unsigned long long>()->default_value(0), "Dump the emulated state after frame N to state-N.dump")
+    ("record-movie", boost::program_options::value<string>(), "Record the controller input of every frame to a movie file")
+    ("play-movie", boost::program_options::value<string>(), "Play back the input of a movie file (yane or FM2), then quit")
+    ("frames", boost::program_options::value<unsigned long long>()->default_value(0), "Stop after N frames, 0 runs until quit")
+    ("stats", boost::program_options::value<string>(), "Write per-frame counters to a file, - for stderr (needs a build with -DYANE_STATS=ON)")
+    ("stats-every", boost::program_options::value<unsigned int>()->default_value(60), "Frames summed per line of --stats")
+    ("render-every", boost::program_options::value<unsigned int>()->default_value(1), "Only draw every Nth frame")
+    ("render-thread", "Draw frames on a separate thread while the next one is emulated")
+    ("scale", boost::program_options::value<unsigned int>()->default_value(0), "Integer scale factor, 0 fits the screen")
+    ("filter", boost::program_options::value<string>()->default_value("nearest"), "Scaling filter: nearest, scale2x, scale3x, scale2x-smooth")
+    ("scale-threads", boost::program_options::value<unsigned int>()->default_value(0), "Threads used for scaling and filtering, 0 picks one per core up to 4")
+    ("overscan", boost::program_options::value<string>()->default_value("0,0,8,8"), "Pixels to crop from the top, bottom, left and right edges")
+    ("ntsc-palette", "Generate the palette from the NTSC signal instead of the built-in RGB values")
+    ("ntsc-filter", "Simulate the composite video signal, with its color artifacts")
+    ("palette-hue", boost::program_options::value<double>()->default_value(0.0), "Hue shift in degrees for --ntsc-palette and --ntsc-filter")
+    ("palette-saturation", boost::program_options::value<double>()->default_value(1.0), "Saturation for --ntsc-palette and --ntsc-filter")
   ;
 
   try
@@ -53,6 +88,115 @@ int main(int argc, char **argv)
       cerr << "Error: No rom file was specified." << endl;
       exit(1);
     }
+    else if (vm["render-every"].as<unsigned int>() == 0)
+    {
+      cout << desc << endl;
+      cerr << "Error: --render-every must be at least 1." << endl;
+      exit(1);
+    }
+
+    std::vector<string> overscan;
+    boost::algorithm::split(overscan, vm["overscan"].as<string>(), boost::algorithm::is_any_of(","));
+
+    if (overscan.size() != 4)
+    {
+      cout << desc << endl;
+      cerr << "Error: --overscan takes four comma separated values." << endl;
+      exit(1);
+    }
+
+    int crop[4];
+
+    for (int i = 0; i < 4; i++)
+    {
+      crop[i] = boost::lexical_cast<int>(boost::algorithm::trim_copy(overscan[i]));
+    }
+
+    if (crop[0] < 0 || crop[1] < 0 || crop[2] < 0 || crop[3] < 0 ||
+      crop[0] + crop[1] >= SCREEN_HEIGHT || crop[2] + crop[3] >= SCREEN_WIDTH)
+    {
+      cout << desc << endl;
+      cerr << "Error: --overscan values can not be negative or crop the whole frame." << endl;
+      exit(1);
+    }
+
+    if (vm.count("state-log") && vm.count("state-compare"))
+    {
+      cout << desc << endl;
+      cerr << "Error: --state-log and --state-compare can not be used together." << endl;
+      exit(1);
+    }
+
+    if (vm.count("record-movie") && vm.count("play-movie"))
+    {
+      cout << desc << endl;
+      cerr << "Error: --record-movie and --play-movie can not be used together." << endl;
+      exit(1);
+    }
+
+#ifndef YANE_STATS
+    if (vm.count("stats"))
+    {
+      cout << desc << endl;
+      cerr << "Error: --stats needs a build with -DYANE_STATS=ON." << endl;
+      exit(1);
+    }
+#endif
+
+    if (vm["shm-slots"].as<unsigned int>() == 0)
+    {
+      cout << desc << endl;
+      cerr << "Error: --shm-slots must be at least 1." << endl;
+      exit(1);
+    }
+
+    std::string shmFormat = vm["shm-format"].as<string>();
+    boost::algorithm::to_lower(shmFormat);
+
+    if (shmFormat == "xrgb8888")
+    {
+      Config::instance().shmFormat = PixelFormat::XRGB8888;
+    }
+    else if (shmFormat == "rgb565")
+    {
+      Config::instance().shmFormat = PixelFormat::RGB565;
+    }
+    else if (shmFormat == "yuv420")
+    {
+      Config::instance().shmFormat = PixelFormat::YUV420;
+    }
+    else
+    {
+      cout << desc << endl;
+      cerr << "Error: Unknown shm format: " << shmFormat << endl;
+      exit(1);
+    }
+
+    std::string filter = vm["filter"].as<string>();
+    boost::algorithm::to_lower(filter);
+
+    if (filter == "nearest")
+    {
+      Config::instance().scaleFilter = ScaleFilter::Nearest;
+    }
+    else if (filter == "scale2x")
+    {
+      Config::instance().scaleFilter = ScaleFilter::Scale2x;
+    }
+    else if (filter == "scale3x")
+    {
+      Config::instance().scaleFilter = ScaleFilter::Scale3x;
+    }
+    else if (filter == "scale2x-smooth")
+    {
+      Config::instance().scaleFilter = ScaleFilter::Scale2xSmooth;
+    }
+    else
+    {
+      cout << desc << endl;
+      cerr << "Error: Unknown filter: " << filter << endl;
+      exit(1);
+    }
 
     // Pass program options to Config singleton
     Config::instance().showRomInfo = vm.count("rom-info");
@@ -60,6 +204,54 @@ int main(int argc, char **argv)
     Config::instance().isNesTest = vm.count("nes-test");
     Config::instance().isBlarghTest = vm.count("blargh-test");
     Config::instance().isFullscreen = vm.count("fullscreen");
+    Config::instance().ntscPalette = vm.count("ntsc-palette");
+    Config::instance().ntscFilter = vm.count("ntsc-filter");
+    Config::instance().paletteHue = vm["palette-hue"].as<double>();
+    Config::instance().paletteSaturation = vm["palette-saturation"].as<double>();
+    Config::instance().renderInterval = vm["render-every"].as<unsigned int>();
+    Config::instance().renderThread = vm.count("render-thread");
+    Config::instance().overscanTop = crop[0];
+    Config::instance().overscanBottom = crop[1];
+    Config::instance().overscanLeft = crop[2];
+    Config::instance().overscanRight = crop[3];
+    Config::instance().scaleFactor = vm["scale"].as<unsigned int>();
+    Config::instance().scaleThreads = vm["scale-threads"].as<unsigned int>();
+    Config::instance().shmName = vm["shm-name"].as<string>();
+    Config::instance().shmSlots = vm["shm-slots"].as<unsigned int>();
+
+    if (vm.count("capture-video"))
+    {
+      Config::instance().captureVideo = vm["capture-video"].as<string>();
+    }
+
+    if (vm.count("state-log"))
+    {
+      Config::instance().stateLog = vm["state-log"].as<string>();
+    }
+
+    if (vm.count("state-compare"))
+    {
+      Config::instance().stateCompare = vm["state-compare"].as<string>();
+    }
+
+    if (vm.count("record-movie"))
+    {
+      Config::instance().recordMovie = vm["record-movie"].as<string>();
+    }
+
+    if (vm.count("play-movie"))
+    {
+      Config::instance().playMovie = vm["play-movie"].as<string>();
+    }
+
+    if (vm.count("stats"))
+    {
+      Config::instance().statsFile = vm["stats"].as<string>();
+    }
+
+    Config::instance().statsInterval = vm["stats-every"].as<unsigned int>();
+    Config::instance().stateDumpFrame = vm["state-dump"].as<unsigned long long>();
+    Config::instance().frameLimit = vm["frames"].as<unsigned long long>();
 
     std::string renderer = vm["renderer"].as<string>();
     boost::algorithm::to_lower(renderer);
@@ -85,7 +277,9 @@ int main(int argc, char **argv)
     exit(1);
   }
 
-  yane.run();
+  yaneInstance = &yane;
+  signal(SIGINT, handleSignal);
+  signal(SIGTERM, handleSignal);
 
-  return 0;
+  return yane.run();
 }
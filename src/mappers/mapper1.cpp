@@ -5,7 +5,8 @@ using namespace std;
 
 Mapper1::Mapper1(boost::shared_ptr<iNes> rom)
 :
-  Cartridge(rom)
+  Cartridge(rom),
+  mirroring(rom->hasVerticalMirroring() ? Mirroring::Vertical : Mirroring::Horizontal)
 {}
 
 void Mapper1::reset()
@@ -19,6 +20,16 @@ void Mapper1::reset()
   reg[0] = reg[1] = reg[2] = reg[3] = 0;
 }
 
+void Mapper1::saveState(machine_state &state)
+{
+  Cartridge::saveState(state);
+
+  std::vector<unsigned char> &registers = state.components[StateComponent::MapperRegisters];
+  pushState(registers, reg, sizeof(reg));
+  pushState(registers, shiftRegister, 1);
+  pushState(registers, shiftCounter, 1);
+}
+
 bool Mapper1::writePrgRom(unsigned short address, unsigned char value)
 {
   if (address < PRG_FIRST_BANK_ADDR)
@@ -17,6 +17,7 @@ public:
   ~Mapper1() {}
   void reset();
   bool writePrgRom(unsigned short address, unsigned char value);
+  void saveState(machine_state &state);
   enum Mirroring getMirroring() { return mirroring; };
   std::string getName() { return "MMC1"; };
 
@@ -1,16 +1,29 @@
 // Based on MMC3 code from Halfnes
+#include <string.h>
 #include "mappers/mapper4.h"
 #include "cpu.h"
+#include "ppu.h"
+#include "scheduler.h"
 
 using namespace std;
 
 Mapper4::Mapper4(
   boost::shared_ptr<iNes> rom,
-  boost::shared_ptr<cpu> cpu)
+  boost::shared_ptr<cpu> cpu,
+  boost::shared_ptr<ppu> ppu,
+  boost::shared_ptr<Scheduler> scheduler)
 :
   Cartridge(rom),
-  _cpu(cpu)
-{}
+  _cpu(cpu.get()),
+  _ppu(ppu.get()),
+  _scheduler(scheduler),
+  mirroring(rom->hasFourScreenMirroring() ? Mirroring::FourScreen : rom->hasVerticalMirroring() ? Mirroring::Vertical : Mirroring::Horizontal)
+{
+  // The IRQ counter is clocked by rising edges on PPU A12. Those are counted
+  // by the PPU, the counter catches up lazily and the IRQ is scheduled ahead.
+  ppu->addA12Observer(this);
+  scheduler->setHandler(SchedulerEvent::MapperIrq, [this]() { a12TimingChanged(); });
+}
 
 void Mapper4::reset()
 {
@@ -19,6 +32,8 @@ void Mapper4::reset()
   irqEnabled = false;
   irqReload = false;
   interrupted = false;
+  irqSyncedRises = _ppu->getA12Rises();
+  _scheduler->cancel(SchedulerEvent::MapperIrq);
 
   bankMode = 0;
   prgMode = 0;
@@ -33,8 +48,39 @@ void Mapper4::reset()
   setupPrg();
 }
 
+void Mapper4::saveState(machine_state &state)
+{
+  Cartridge::saveState(state);
+
+  std::vector<unsigned char> &registers = state.components[StateComponent::MapperRegisters];
+  pushState(registers, bankMode, 1);
+  pushState(registers, prgMode, 1);
+  pushState(registers, chrMode, 1);
+  pushState(registers, chrBanks, sizeof(chrBanks));
+  pushState(registers, prgBank, 1);
+  pushState(registers, irqCounterReload, 1);
+  pushState(registers, irqEnabled, 1);
+  pushState(registers, interrupted, 1);
+
+  // The counter as it would be after catching up. It is clocked on copies,
+  // an IRQ it finds is delivered by the scheduled event as usual.
+  unsigned char counter = irqCounter;
+  bool reload = irqReload;
+  clockIrqCounter(_ppu->getA12Rises() - irqSyncedRises);
+  pushState(registers, irqCounter, 1);
+  pushState(registers, irqReload, 1);
+  irqCounter = counter;
+  irqReload = reload;
+}
+
 bool Mapper4::writePrgRom(unsigned short address, unsigned char value)
 {
+  // Bring the IRQ counter up to date before its registers change
+  if (address >= 0xC000)
+  {
+    syncIrq();
+  }
+
   // Odd addresses
   if (address & 0x1)
   {
@@ -109,35 +155,95 @@ bool Mapper4::writePrgRom(unsigned short address, unsigned char value)
     }
   }
 
+  if (address >= 0xC000)
+  {
+    scheduleIrq();
+  }
+
   return true;
 }
 
-void Mapper4::irqTick()
+// Only delivered while the PPU can't predict rises (8x16 sprites)
+void Mapper4::a12Rise()
 {
+  syncIrq();
+}
+
+// Also the handler of the scheduled IRQ event
+void Mapper4::a12TimingChanged()
+{
+  syncIrq();
+  scheduleIrq();
+}
+
+// Apply the rises the PPU has counted since the last sync
+void Mapper4::syncIrq()
+{
+  unsigned long long rises = _ppu->getA12Rises();
+  bool fired = clockIrqCounter(rises - irqSyncedRises);
+  irqSyncedRises = rises;
+
+  if (fired && irqEnabled && !interrupted)
+  {
+    _cpu->enqueueInterrupt(Interrupt::Irq);
+    interrupted = true;
+  }
+}
+
+// Register the cycle of the rise that will take the counter to zero
+void Mapper4::scheduleIrq()
+{
+  unsigned long long cycles = SCHEDULER_NEVER;
+
+  if (irqEnabled && !interrupted && irqCounterReload != 0)
+  {
+    unsigned char counter = irqReload ? irqCounterReload : irqCounter;
+    cycles = _ppu->cyclesUntilA12Rise(irqSyncedRises + counter + 1);
+  }
+
+  if (cycles == SCHEDULER_NEVER)
+  {
+    _scheduler->cancel(SchedulerEvent::MapperIrq);
+  }
+  else
+  {
+    _scheduler->schedule(SchedulerEvent::MapperIrq, _scheduler->getCycles() + cycles);
+  }
+}
+
+// Run the counter through a number of A12 rises at once. Returns true if it
+// was clocked at zero with a non-zero reload value, which is when an IRQ fires.
+bool Mapper4::clockIrqCounter(unsigned long long clocks)
+{
+  if (clocks == 0)
+  {
+    return false;
+  }
+
   if (irqReload)
   {
     irqReload = false;
     irqCounter = irqCounterReload;
   }
 
-  if (irqCounter-- <= 0)
+  if (clocks <= irqCounter)
   {
-    if (irqCounterReload == 0)
-    {
-      return;
-    }
+    irqCounter -= clocks;
+    return false;
+  }
 
-    if (irqEnabled)
-    {
-      if (!interrupted)
-      {
-        _cpu->enqueueInterrupt(Interrupt::Irq);
-        interrupted = true;
-      }
-    }
+  // Clocks left after the one that found the counter at zero
+  clocks -= irqCounter + 1;
 
-    irqCounter = irqCounterReload;
+  // A zero reload value lets the counter wrap around without firing
+  if (irqCounterReload == 0)
+  {
+    irqCounter = 0xFF - (clocks % 0x100);
+    return false;
   }
+
+  irqCounter = irqCounterReload - (clocks % (irqCounterReload + 1));
+  return true;
 }
 
 void Mapper4::setupChr()
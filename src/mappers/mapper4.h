@@ -2,8 +2,11 @@
 #define _MAPPER4_H_
 
 #include "cartridge.h"
+#include "ppu_bus_observer.h"
 
 class cpu;
+class ppu;
+class Scheduler;
 
 #define MMC3_SELECT_BANK  0x07
 #define MMC3_PRG_MODE    0x40
@@ -12,21 +15,33 @@ class cpu;
 
 #define MMC3_IRQ_RELOAD_INIT  0xFF
 
-class Mapper4 : public Cartridge
+class Mapper4 : public Cartridge, public PpuBusObserver
 {
 public:
-  Mapper4(boost::shared_ptr<iNes> rom, boost::shared_ptr<cpu> cpu);
+  Mapper4(
+    boost::shared_ptr<iNes> rom,
+    boost::shared_ptr<cpu> cpu,
+    boost::shared_ptr<ppu> ppu,
+    boost::shared_ptr<Scheduler> scheduler);
   void reset();
   std::string getName() { return "MMC3"; };
   bool writePrgRom(unsigned short address, unsigned char value);
+  void saveState(machine_state &state);
   enum Mirroring getMirroring() { return mirroring; };
-  void irqTick();
+  void a12Rise();
+  void a12TimingChanged();
 
 private:
-  boost::shared_ptr<cpu> _cpu;
+  // Both own the cartridge, shared pointers back to them would never be freed
+  cpu *_cpu;
+  ppu *_ppu;
+  boost::shared_ptr<Scheduler> _scheduler;
 
   void setupChr();
   void setupPrg();
+  void syncIrq();
+  void scheduleIrq();
+  bool clockIrqCounter(unsigned long long clocks);
 
   enum Mirroring mirroring;
   unsigned char bankMode;
@@ -40,6 +55,7 @@ private:
   bool irqEnabled;
   bool irqReload;
   bool interrupted;
+  unsigned long long irqSyncedRises;
 };
 
 #endif
@@ -4,7 +4,8 @@ using namespace std;
 
 Mapper7::Mapper7(boost::shared_ptr<iNes> rom)
 :
-  Cartridge(rom)
+  Cartridge(rom),
+  mirroring(Mirroring::SingleScreenLowerBank)
 {}
 
 void Mapper7::reset()
@@ -1,12 +1,18 @@
 #include "mappers/mapper9.h"
+#include "ppu.h"
 #include <string.h>
 
 using namespace std;
 
-Mapper9::Mapper9(boost::shared_ptr<iNes> rom)
+Mapper9::Mapper9(boost::shared_ptr<iNes> rom, boost::shared_ptr<ppu> ppu)
 :
-  Cartridge(rom)
-{}
+  Cartridge(rom),
+  mirroring(rom->hasVerticalMirroring() ? Mirroring::Vertical : Mirroring::Horizontal)
+{
+  // Latches flip when the PPU fetches tile $FD or $FE from either pattern table
+  ppu->addFetchObserver(this, 0x0FD0, 0x0FEF);
+  ppu->addFetchObserver(this, 0x1FD0, 0x1FEF);
+}
 
 void Mapper9::reset()
 {
@@ -23,6 +29,15 @@ void Mapper9::reset()
   mapPrg8Kb(0xE000, lastBank);
 }
 
+void Mapper9::saveState(machine_state &state)
+{
+  Cartridge::saveState(state);
+
+  std::vector<unsigned char> &registers = state.components[StateComponent::MapperRegisters];
+  pushState(registers, latch, 1);
+  pushState(registers, latchData, sizeof(latchData));
+}
+
 bool Mapper9::writePrgRom(unsigned short address, unsigned char value)
 {
   unsigned short addr = (address >> 12) & 0x07;
@@ -71,22 +86,18 @@ bool Mapper9::writePrgRom(unsigned short address, unsigned char value)
   return false;
 }
 
-bool Mapper9::readChrRom(unsigned short address, unsigned char &value)
+void Mapper9::watchedFetch(unsigned short address)
 {
   unsigned char bank = address >> 12;
 
-  if ((address >= 0x0FD0 && address <= 0x0FDF) ||
-    (address >= 0x1FD0 && address <= 0x1FDF))
+  if ((address & 0x0FF0) == 0x0FD0)
   {
     latch = 0xFD;
     mapChr4Kb(bank ? CHR_SECOND_BANK_ADDR : CHR_FIRST_BANK_ADDR, latchData[0]);
   }
-  else if ((address >= 0x0FE0 && address <= 0x0FEF) ||
-    (address >= 0x1FE0 && address <= 0x1FEF))
+  else if ((address & 0x0FF0) == 0x0FE0)
   {
     latch = 0xFE;
     mapChr4Kb(bank ? CHR_SECOND_BANK_ADDR : CHR_FIRST_BANK_ADDR, latchData[1]);
   }
-
-  return Cartridge::readChrRom(address, value);
 }
@@ -2,19 +2,23 @@
 #define _MAPPER9_H_
 
 #include "cartridge.h"
+#include "ppu_bus_observer.h"
+
+class ppu;
 
 #define MMC2_MIRRORING 0x01
 #define MMC2_LATCH_INIT 0xFE
 #define MMC2_LATCHES  2
 
-class Mapper9 : public Cartridge
+class Mapper9 : public Cartridge, public PpuBusObserver
 {
 public:
-  Mapper9(boost::shared_ptr<iNes> rom);
+  Mapper9(boost::shared_ptr<iNes> rom, boost::shared_ptr<ppu> ppu);
   void reset();
   std::string getName() { return "MMC2"; };
   bool writePrgRom(unsigned short address, unsigned char value);
-  bool readChrRom(unsigned short address, unsigned char &value);
+  void saveState(machine_state &state);
+  void watchedFetch(unsigned short address);
   enum Mirroring getMirroring() { return mirroring; };
 
 private:
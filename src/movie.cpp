@@ -0,0 +1,198 @@
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <boost/algorithm/string.hpp>
+
+#include "movie.h"
+#include "yane_exception.h"
+
+#define FM2_GAMEPAD_BUTTONS  8  // "RLDUTSBA", Right is the highest bit
+#define FM2_SOFT_RESET       0x01
+#define FM2_HARD_RESET       0x02
+
+Movie::Movie(std::string filename, enum MovieMode mode, unsigned long long romHash)
+:
+  filename(filename),
+  mode(mode),
+  recorded(0)
+{
+  if (mode == MovieMode::RecordMovie)
+  {
+    output.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!output.is_open())
+    {
+      throw MovieException(filename, strerror(errno));
+    }
+
+    movie_header header = { MOVIE_MAGIC, MOVIE_VERSION, romHash };
+    output.write((const char*)&header, sizeof(header));
+    return;
+  }
+
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+
+  if (!file.is_open())
+  {
+    throw MovieException(filename, strerror(errno));
+  }
+
+  unsigned int magic = 0;
+  file.read((char*)&magic, sizeof(magic));
+  file.seekg(0, std::ios::beg);
+
+  if (magic == MOVIE_MAGIC)
+  {
+    load(file, romHash);
+  }
+  else
+  {
+    loadFm2(file);
+  }
+}
+
+Movie::~Movie()
+{
+  close();
+}
+
+void Movie::close()
+{
+  if (output.is_open())
+  {
+    output.close();
+  }
+}
+
+const movie_frame *Movie::getFrame(size_t index)
+{
+  return index < frames.size() ? &frames[index] : NULL;
+}
+
+void Movie::record(const movie_frame &frame)
+{
+  output.write((const char*)&frame, sizeof(frame));
+  recorded++;
+}
+
+void Movie::load(std::ifstream &file, unsigned long long romHash)
+{
+  movie_header header;
+  file.read((char*)&header, sizeof(header));
+
+  if (!file || header.version != MOVIE_VERSION)
+  {
+    throw MovieException(filename, "Unsupported movie version");
+  }
+
+  if (header.romHash != romHash)
+  {
+    throw MovieException(filename, "Recorded with a different rom");
+  }
+
+  // A partial record at the end is left out
+  movie_frame frame;
+
+  while (file.read((char*)&frame, sizeof(frame)))
+  {
+    frames.push_back(frame);
+  }
+}
+
+// FM2 is a text format: "key value" header lines, then one line per frame
+// like "|0|RLDUTSBA|........||". Gamepads are the only supported devices.
+// Its rom checksum is an MD5 sum, so the rom is not checked.
+void Movie::loadFm2(std::ifstream &file)
+{
+  std::string line;
+  int gamepads[CONTROLLER_PORTS] = { 1, 1 };
+  bool isFourScore = false;
+
+  while (std::getline(file, line))
+  {
+    boost::algorithm::trim(line);
+
+    if (line.empty())
+    {
+      continue;
+    }
+
+    if (line[0] != '|')
+    {
+      std::string key = line.substr(0, line.find(' '));
+      std::string value = line.size() > key.size() ? boost::algorithm::trim_copy(line.substr(key.size())) : "";
+
+      if (key == "binary" && value != "0")
+      {
+        throw MovieException(filename, "Binary FM2 input is not supported");
+      }
+      else if (key == "savestate" && !value.empty())
+      {
+        throw MovieException(filename, "Movies starting from a savestate are not supported");
+      }
+      else if (key == "fourscore")
+      {
+        isFourScore = value == "1";
+      }
+      else if (key == "port0" || key == "port1")
+      {
+        int device = atoi(value.c_str());
+
+        if (device > 1)
+        {
+          throw MovieException(filename, "Only gamepads are supported");
+        }
+
+        gamepads[key[4] - '0'] = device;
+      }
+
+      continue;
+    }
+
+    // Fields are the commands, then one per port, empty if nothing is
+    // plugged in
+    std::vector<std::string> fields;
+    boost::algorithm::split(fields, line, boost::algorithm::is_any_of("|"));
+
+    movie_frame frame;
+    memset(&frame, 0, sizeof(frame));
+    int commands = fields.size() > 1 ? atoi(fields[1].c_str()) : 0;
+
+    // The power on of the first frame is where playback starts anyway
+    if ((commands & (FM2_SOFT_RESET | FM2_HARD_RESET)) && !frames.empty())
+    {
+      frame.flags |= MOVIE_RESET;
+    }
+
+    for (int port = 0; port < CONTROLLER_PORTS; port++)
+    {
+      size_t field = 2 + port;
+
+      if (!isFourScore && !gamepads[port])
+      {
+        continue;
+      }
+
+      if (field >= fields.size() || fields[field].size() < FM2_GAMEPAD_BUTTONS)
+      {
+        throw MovieException(filename, "Invalid input line " + boost::lexical_cast<std::string>(frames.size() + 1));
+      }
+
+      for (int i = 0; i < FM2_GAMEPAD_BUTTONS; i++)
+      {
+        char button = fields[field][i];
+
+        if (button != '.' && button != ' ')
+        {
+          frame.buttons[port] |= 1 << (FM2_GAMEPAD_BUTTONS - 1 - i);
+        }
+      }
+    }
+
+    frames.push_back(frame);
+  }
+
+  std::cout << "Playing FM2 movie " << filename << ", it can not be checked against the rom" << std::endl;
+}
@@ -0,0 +1,55 @@
+#ifndef _MOVIE_H_
+#define _MOVIE_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include "cpu.h"
+
+#define MOVIE_MAGIC    0x31564D59  // "YMV1"
+#define MOVIE_VERSION  1
+#define MOVIE_RESET    0x01  // Frame flag, reset before the frame starts
+
+// A movie file is the header followed by one record per frame, from power on
+typedef struct
+{
+  unsigned int magic;
+  unsigned int version;
+  unsigned long long romHash;  // iNes::getDataHash()
+} movie_header;
+
+typedef struct
+{
+  unsigned char flags;
+  unsigned char buttons[CONTROLLER_PORTS];  // See cpu::getInput()
+} movie_frame;
+
+enum MovieMode { RecordMovie, PlayMovie };
+
+// Controller input per frame, recorded to a file or played back from one.
+// Playback also reads FCEUX FM2 movies.
+class Movie
+{
+public:
+  Movie(std::string filename, enum MovieMode mode, unsigned long long romHash);
+  ~Movie();
+  enum MovieMode getMode() { return mode; };
+  size_t getFrameCount() { return mode == MovieMode::PlayMovie ? frames.size() : recorded; };
+
+  // NULL once the movie has ended
+  const movie_frame *getFrame(size_t index);
+  void record(const movie_frame &frame);
+  void close();
+
+private:
+  std::string filename;
+  enum MovieMode mode;
+  std::ofstream output;
+  std::vector<movie_frame> frames;
+  size_t recorded;
+
+  void load(std::ifstream &file, unsigned long long romHash);
+  void loadFm2(std::ifstream &file);
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <boost/assert.hpp>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ntsc_filter.h"
+#include "palette.h"
+
+#define NTSC_PIXEL_SAMPLES   8   // Signal samples per input pixel, the master clock runs at 12 per color cycle
+#define NTSC_GROUP_SAMPLES   24  // Samples of a 3 pixel group
+#define NTSC_GROUP_OUTPUT    7   // Output pixels of a 3 pixel group
+#define NTSC_LINE_SHIFT      4   // Phase shift of each scanline, 341 * 8 samples
+#define NTSC_FRAME_SHIFT     4   // Phase shift between the frames of a pair, odd frames skip a dot
+#define NTSC_SUM_SIZE        ((NTSC_OUTPUT_WIDTH + NTSC_KERNEL_SIZE) * 4)
+
+// Rounds half to even like _mm_cvtps_epi32 does in the default rounding
+// mode, so the SSE2 and scalar paths give the same bytes
+static inline int toByte(float value)
+{
+  return std::min(std::max((int)lrintf(value), 0), 255);
+}
+
+NtscFilter::NtscFilter(enum PixelFormat format, const overscan_crop &crop, double hue, double saturation, boost::shared_ptr<BandWorkers> workers)
+:
+  format(format),
+  crop(crop),
+  outputLeft((crop.left * NTSC_GROUP_OUTPUT + 1) / 3),
+  width(NTSC_OUTPUT_WIDTH - outputLeft - (crop.right * NTSC_GROUP_OUTPUT + 1) / 3),
+  height(SCREEN_HEIGHT - crop.top - crop.bottom),
+  framePhase(0),
+  frame(NULL),
+  output(NULL),
+  pitch(0),
+  workers(workers)
+{
+  BOOST_ASSERT_MSG(format != PixelFormat::YUV420, "The NTSC filter outputs RGB");
+  BOOST_ASSERT_MSG(width > 0 && height > 0, "Overscan crop is larger than the frame");
+
+  buildKernels(hue, saturation);
+  rowBuffers.resize(workers->getBands(), std::vector<float>(NTSC_SUM_SIZE));
+}
+
+// The luma filter averages one color cycle and the chroma filter two, with
+// triangular weights. Both cancel the other component on flat colors, so
+// those decode to the colors of the generated NTSC palette.
+void NtscFilter::buildKernels(double hue, double saturation)
+{
+  kernels.resize(PALETTE_TABLE_SIZE * NTSC_LINE_PHASES * 3 * NTSC_KERNEL_SIZE * 4);
+
+  for (int index = 0; index < PALETTE_TABLE_SIZE; index++)
+  {
+    for (int linePhase = 0; linePhase < NTSC_LINE_PHASES; linePhase++)
+    {
+      for (int pixel = 0; pixel < 3; pixel++)
+      {
+        float *kernel = &kernels[((index * NTSC_LINE_PHASES + linePhase) * 3 + pixel) * NTSC_KERNEL_SIZE * 4];
+
+        for (int out = 0; out < NTSC_KERNEL_SIZE; out++)
+        {
+          double center = (out - NTSC_KERNEL_START + 0.5) * NTSC_GROUP_SAMPLES / NTSC_GROUP_OUTPUT;
+          double y = 0.0, i = 0.0, q = 0.0, rgb[3];
+
+          for (int sample = 0; sample < NTSC_PIXEL_SAMPLES; sample++)
+          {
+            int position = pixel * NTSC_PIXEL_SAMPLES + sample;
+            int phase = (linePhase * NTSC_LINE_SHIFT + position) % NTSC_PHASES;
+            double value = palette::ntscSignal(index, phase);
+            double distance = fabs(center - position - 0.5);
+            double angle = M_PI * (phase + NTSC_PHASE_OFFSET) / (NTSC_PHASES / 2) + hue * M_PI / 180.0;
+
+            if (distance < NTSC_PHASES / 2)
+            {
+              y += value / NTSC_PHASES;
+            }
+
+            if (distance < NTSC_PHASES)
+            {
+              double weight = (NTSC_PHASES - distance) / (NTSC_PHASES * NTSC_PHASES);
+              i += value * cos(angle) * weight;
+              q += value * sin(angle) * weight;
+            }
+          }
+
+          palette::yiqToRgb(y, i * saturation, q * saturation, rgb);
+          kernel[out * 4] = rgb[2] * 255.0;
+          kernel[out * 4 + 1] = rgb[1] * 255.0;
+          kernel[out * 4 + 2] = rgb[0] * 255.0;
+          kernel[out * 4 + 3] = 0.0;
+        }
+      }
+    }
+  }
+}
+
+void NtscFilter::convert(const unsigned short *frame, unsigned char *output, int pitch)
+{
+  this->frame = frame;
+  this->output = output;
+  this->pitch = pitch ? pitch : getWidth() * (format == PixelFormat::RGB565 ? 2 : 4);
+
+  workers->run([this](int band) { filterBand(band); });
+  framePhase ^= NTSC_FRAME_SHIFT;
+}
+
+void NtscFilter::filterBand(int band)
+{
+  int bands = workers->getBands();
+  float *sum = rowBuffers[band].data();
+
+  for (int y = band * height / bands; y < (band + 1) * height / bands; y++)
+  {
+    int line = y + crop.top;
+    int linePhase = ((framePhase + line * NTSC_LINE_SHIFT) % NTSC_PHASES) / NTSC_LINE_SHIFT;
+    unsigned char *out = output + 2 * y * pitch;
+    const float *pixels = sum + (outputLeft + NTSC_KERNEL_START) * 4;
+
+    filterRow(frame + line * SCREEN_WIDTH, linePhase, sum);
+
+    if (format == PixelFormat::RGB565)
+    {
+      unsigned short *row = (unsigned short*)out;
+
+      for (int x = 0; x < width; x++)
+      {
+        int b = toByte(pixels[x * 4]);
+        int g = toByte(pixels[x * 4 + 1]);
+        int r = toByte(pixels[x * 4 + 2]);
+        row[x] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+      }
+    }
+    else
+    {
+      unsigned int *row = (unsigned int*)out;
+      int x = 0;
+
+#ifdef __SSE2__
+      // Saturating packs clamp two pixels at a time to bytes
+      for (; x + 2 <= width; x += 2)
+      {
+        __m128i first = _mm_cvtps_epi32(_mm_loadu_ps(pixels + x * 4));
+        __m128i second = _mm_cvtps_epi32(_mm_loadu_ps(pixels + x * 4 + 4));
+        __m128i words = _mm_packs_epi32(first, second);
+        _mm_storel_epi64((__m128i*)(row + x), _mm_packus_epi16(words, words));
+      }
+#endif
+
+      for (; x < width; x++)
+      {
+        int b = toByte(pixels[x * 4]);
+        int g = toByte(pixels[x * 4 + 1]);
+        int r = toByte(pixels[x * 4 + 2]);
+        row[x] = (r << 16) | (g << 8) | b;
+      }
+    }
+
+    memcpy(out + pitch, out, getWidth() * (format == PixelFormat::RGB565 ? 2 : 4));
+  }
+}
+
+// Sum the kernels of a full scanline, the sum starts NTSC_KERNEL_START
+// pixels left of the first output pixel
+void NtscFilter::filterRow(const unsigned short *row, int linePhase, float *sum)
+{
+  memset(sum, 0, NTSC_SUM_SIZE * sizeof(float));
+
+  for (int x = 0; x < SCREEN_WIDTH; x++)
+  {
+    const float *kernel = &kernels[((row[x] * NTSC_LINE_PHASES + linePhase) * 3 + x % 3) * NTSC_KERNEL_SIZE * 4];
+    float *target = sum + (x / 3) * NTSC_GROUP_OUTPUT * 4;
+
+#ifdef __SSE2__
+    for (int i = 0; i < NTSC_KERNEL_SIZE * 4; i += 4)
+    {
+      _mm_storeu_ps(target + i, _mm_add_ps(_mm_loadu_ps(target + i), _mm_loadu_ps(kernel + i)));
+    }
+#else
+    for (int i = 0; i < NTSC_KERNEL_SIZE * 4; i++)
+    {
+      target[i] += kernel[i];
+    }
+#endif
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef _NTSC_FILTER_H_
+#define _NTSC_FILTER_H_
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "frame_converter.h"
+#include "band_workers.h"
+
+#define NTSC_OUTPUT_WIDTH    602  // 7 output pixels for every 3 input pixels
+#define NTSC_KERNEL_SIZE     16   // Output pixels an input pixel reaches
+#define NTSC_KERNEL_START    4    // How many of them lie left of its pixel group
+#define NTSC_LINE_PHASES     3
+
+// Simulates the composite signal of each scanline and decodes it the way a
+// TV would, which gives the color artifacts and fringes the games were made
+// for. Decoding is linear, so the output each input pixel contributes is a
+// precomputed kernel per color, line phase and position in its 3 pixel group,
+// and a scanline is the sum of its pixels' kernels. Rows are doubled to keep
+// the aspect ratio.
+class NtscFilter
+{
+public:
+  NtscFilter(enum PixelFormat format, const overscan_crop &crop, double hue, double saturation, boost::shared_ptr<BandWorkers> workers);
+  int getWidth() { return width; };
+  int getHeight() { return height * 2; };
+  int getFrameSize() { return getWidth() * getHeight() * (format == PixelFormat::RGB565 ? 2 : 4); };
+
+  // Output rows are `pitch` bytes apart, or packed if it is 0
+  void convert(const unsigned short *frame, unsigned char *output, int pitch = 0);
+
+private:
+  enum PixelFormat format;
+  overscan_crop crop;
+  int outputLeft;
+  int width;
+  int height;
+  int framePhase;
+  const unsigned short *frame;
+  unsigned char *output;
+  int pitch;
+
+  // BGR and padding per output pixel, so a pixel is one SIMD add
+  std::vector<float> kernels;
+  std::vector<std::vector<float> > rowBuffers;
+  boost::shared_ptr<BandWorkers> workers;
+
+  void buildKernels(double hue, double saturation);
+  void filterBand(int band);
+  void filterRow(const unsigned short *row, int linePhase, float *sum);
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include <math.h>
+#include "palette.h"
+
+#define EMPHASIS_ATTENUATION  0.746
+#define NTSC_BLACK        0.518
+#define NTSC_WHITE        1.962
+
+namespace palette
+{
+  static unsigned char clampColor(double value)
+  {
+    if (value <= 0.0)
+    {
+      return 0;
+    }
+    else if (value >= 1.0)
+    {
+      return 255;
+    }
+
+    return (unsigned char)(value * 255.0 + 0.5);
+  }
+
+  // Every emphasis bit dims the two other channels
+  void applyEmphasis(const std::vector<palette_entry> &colors, palette_entry *table)
+  {
+    for (int emphasis = 0; emphasis < PALETTE_EMPHASIS_LEVELS; emphasis++)
+    {
+      double red = 1.0, green = 1.0, blue = 1.0;
+
+      if (emphasis & 0x01)
+      {
+        green *= EMPHASIS_ATTENUATION;
+        blue *= EMPHASIS_ATTENUATION;
+      }
+
+      if (emphasis & 0x02)
+      {
+        red *= EMPHASIS_ATTENUATION;
+        blue *= EMPHASIS_ATTENUATION;
+      }
+
+      if (emphasis & 0x04)
+      {
+        red *= EMPHASIS_ATTENUATION;
+        green *= EMPHASIS_ATTENUATION;
+      }
+
+      for (int color = 0; color < PALETTE_COLORS; color++)
+      {
+        palette_entry &entry = table[(emphasis << 6) | color];
+        entry.r = clampColor(colors[color].r * red / 255.0);
+        entry.g = clampColor(colors[color].g * green / 255.0);
+        entry.b = clampColor(colors[color].b * blue / 255.0);
+      }
+    }
+  }
+
+  // Composite signal level of a color at one of the 12 phases of the color
+  // cycle (http://wiki.nesdev.com/w/index.php/NTSC_video), 0 is black and
+  // 1 is white
+  double ntscSignal(int index, int phase)
+  {
+    static const double levelsLow[4] = { 0.350, 0.518, 0.962, 1.550 };
+    static const double levelsHigh[4] = { 1.094, 1.506, 1.962, 1.962 };
+
+    int color = index & 0x0F;
+    int level = (color > 0x0D) ? 1 : (index >> 4) & 0x03;
+    int emphasis = index >> 6;
+    double low = levelsLow[level];
+    double high = levelsHigh[level];
+
+    // Color 0 is a flat high level, colors $D-$F a flat low level
+    if (color == 0x00)
+    {
+      low = high;
+    }
+    else if (color > 0x0C)
+    {
+      high = low;
+    }
+
+    double signal = ((color + phase) % NTSC_PHASES < NTSC_PHASES / 2) ? high : low;
+
+    // Emphasis attenuates the signal during part of the color cycle
+    if (color < 0x0E &&
+      (((emphasis & 0x01) && (0x0C + phase) % NTSC_PHASES < NTSC_PHASES / 2) ||
+      ((emphasis & 0x02) && (0x04 + phase) % NTSC_PHASES < NTSC_PHASES / 2) ||
+      ((emphasis & 0x04) && (0x08 + phase) % NTSC_PHASES < NTSC_PHASES / 2)))
+    {
+      signal *= EMPHASIS_ATTENUATION;
+    }
+
+    return (signal - NTSC_BLACK) / (NTSC_WHITE - NTSC_BLACK);
+  }
+
+  void yiqToRgb(double y, double i, double q, double *rgb)
+  {
+    rgb[0] = y + 0.946882 * i + 0.623557 * q;
+    rgb[1] = y - 0.274788 * i - 0.635691 * q;
+    rgb[2] = y - 1.108545 * i + 1.709007 * q;
+  }
+
+  // Sample one cycle of the composite signal the PPU outputs for each color
+  // and decode it as YIQ
+  void generateNtsc(double hue, double saturation, palette_entry *table)
+  {
+    for (int index = 0; index < PALETTE_TABLE_SIZE; index++)
+    {
+      double y = 0.0, i = 0.0, q = 0.0, rgb[3];
+
+      for (int phase = 0; phase < NTSC_PHASES; phase++)
+      {
+        double value = ntscSignal(index, phase);
+        double angle = M_PI * (phase + NTSC_PHASE_OFFSET) / (NTSC_PHASES / 2) + hue * M_PI / 180.0;
+        y += value;
+        i += value * cos(angle);
+        q += value * sin(angle);
+      }
+
+      y /= NTSC_PHASES;
+      i *= saturation / NTSC_PHASES;
+      q *= saturation / NTSC_PHASES;
+      yiqToRgb(y, i, q, rgb);
+
+      table[index].r = clampColor(rgb[0]);
+      table[index].g = clampColor(rgb[1]);
+      table[index].b = clampColor(rgb[2]);
+    }
+  }
+}
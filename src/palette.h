@@ -0,0 +1,20 @@
+#ifndef _PALETTE_H_
+#define _PALETTE_H_
+
+#include <vector>
+#include "ppu.h"
+
+#define NTSC_PHASES        12
+#define NTSC_PHASE_OFFSET    4.0
+
+// Color tables are indexed by (emphasis << 6) | color, where emphasis holds
+// the red, green and blue bits of PPUMASK in bits 0, 1 and 2
+namespace palette
+{
+  void applyEmphasis(const std::vector<palette_entry> &colors, palette_entry *table);
+  void generateNtsc(double hue, double saturation, palette_entry *table);
+  double ntscSignal(int index, int phase);
+  void yiqToRgb(double y, double i, double q, double *rgb);
+}
+
+#endif
@@ -1,6 +1,10 @@
 #include <iostream>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "cartridge.h"
 #include "renderer.h"
 #include "ppu.h"
@@ -9,6 +13,11 @@
 #include "yane.h"
 #include "yane_exception.h"
 #include "utils.h"
+#include "scheduler.h"
+#include "palette.h"
+#include "render_worker.h"
+#include "capture_writer.h"
+#include "stats.h"
 
 using namespace std;
 
@@ -17,9 +26,51 @@ ppu::ppu()
   _mapper = nullptr;
   _cpu = nullptr;
   _isInitialized = false;
+  chrPages = NULL;
+  a12High = false;
+  a12LowSince = 0;
+  a12Rises = 0;
+  frameCount = 0;
 
   isVblank = false;
   isNmiExecuted = false;
+  spriteZeroHitDot = SPRITE_ZERO_NO_HIT;
+  memset(frameBuffer, 0, sizeof(frameBuffer));
+
+  // Nothing is logged until the first frame starts
+  frameLog = &frameLogs[0];
+  frameLog->lineCount = 0;
+  frameLog->drawnLines = 0;
+  frameLog->paletteCount = 0;
+  frameLog->oamCount = 0;
+  frameLog->splitCount = 0;
+  isFrameRequested = false;
+  isFramePending = false;
+  paletteDirty = true;
+  oamDirty = true;
+  nameTablesDirty = true;
+  chrRamDirty = true;
+  hasChrRam = false;
+
+  // One byte per pixel, 0 or 1, leftmost pixel first in memory
+  for (int value = 0; value < 256; value++)
+  {
+    unsigned char pixels[TILE_WIDTH];
+
+    for (int pixelNum = 0; pixelNum < TILE_WIDTH; pixelNum++)
+    {
+      pixels[pixelNum] = (value & (0x80 >> pixelNum)) ? 1 : 0;
+    }
+
+    memcpy(&patternSpread[value], pixels, TILE_WIDTH);
+
+    patternReverse[value] = 0;
+
+    for (int pixelNum = 0; pixelNum < TILE_WIDTH; pixelNum++)
+    {
+      patternReverse[value] |= pixels[pixelNum] << pixelNum;
+    }
+  }
 
   transferLatch = false;
   transferLatchScroll = false;
@@ -28,6 +79,10 @@ ppu::ppu()
   video_memory = new unsigned char[VRAM_SIZE];
   sprite_memory = new unsigned char[SPRITE_RAM_SIZE];
   memset(video_memory, 0, VRAM_SIZE);
+  memset(attributeShadow, 0, sizeof(attributeShadow));
+  memset(paletteCache, 0, sizeof(paletteCache));
+  paletteCacheMask = 0;
+  paletteCacheSnapshot = PALETTE_SNAPSHOT_NONE;
   memset(sprite_memory, 0, SPRITE_RAM_SIZE);
   vram_access_flipflop = false;
   vram_address = 0;
@@ -76,6 +131,16 @@ ppu::ppu()
     {248,216,120}, {216,248,120}, {184,248,184}, {184,248,216},
     {0,252,252}, {248,216,248}, {0,0,0}, {0,0,0},
   };
+
+  // Expand it with color emphasis, or replace it with a generated one
+  if (Config::instance().ntscPalette)
+  {
+    palette::generateNtsc(Config::instance().paletteHue, Config::instance().paletteSaturation, colorTable);
+  }
+  else
+  {
+    palette::applyEmphasis(palette_table, colorTable);
+  }
 }
 
 ppu::~ppu()
@@ -87,14 +152,36 @@ ppu::~ppu()
 void ppu::init(
   boost::shared_ptr<Cartridge> mapper,
   boost::shared_ptr<Renderer> renderer,
-  boost::shared_ptr<cpu> cpu)
+  boost::shared_ptr<cpu> cpu,
+  boost::shared_ptr<Scheduler> scheduler)
 {
   _mapper = mapper;
   _renderer = renderer;
   _isInitialized = cpu ? true : false;
   _cpu = cpu;
+  _scheduler = scheduler;
+  syncedCycles = scheduler->getCycles();
+  chrPages = mapper->getChrPageTable();
+  hasChrRam = mapper->hasChrRam();
 
+  scheduler->setHandler(SchedulerEvent::PpuCatchUp, [this]()
+  {
+    catchUp();
+    scheduleCatchUp();
+  });
+
+  renderer->setColors(colorTable);
   renderer->init();
+
+  Config &config = Config::instance();
+
+  if (!config.captureVideo.empty())
+  {
+    // Mappers watching pattern fetches get every frame drawn, see isFrameWanted()
+    overscan_crop crop = { config.overscanTop, config.overscanBottom, config.overscanLeft, config.overscanRight };
+    unsigned int frameInterval = fetchWatches.empty() ? config.renderInterval : 1;
+    captureWriter = boost::make_shared<CaptureWriter>(config.captureVideo, colorTable, crop, frameInterval);
+  }
 }
 
 void ppu::start()
@@ -102,8 +189,28 @@ void ppu::start()
   BOOST_ASSERT_MSG(_cpu, "PPU is not initialized");
 
   clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &lastScreenUpdate);
-  scanline = previousScanline = SCANLINE_INIT;
+  scanline = SCANLINE_INIT;
   ppuCycles = 0;
+  syncedCycles = _scheduler->getCycles();
+  scheduleCatchUp();
+
+  // Draw frames on a separate thread, unless a mapper has to see the pattern
+  // fetches as they happen. The worker only fills the frame buffer, the
+  // renderer isn't thread safe and is updated from here.
+  if (Config::instance().renderThread && fetchWatches.empty() && !_renderer->isHeadless())
+  {
+    renderWorker = boost::make_shared<RenderWorker>([this](frame_log *log)
+    {
+      drawLoggedLines(*log);
+    });
+
+    renderWorker->start();
+  }
+
+  if (captureWriter)
+  {
+    captureWriter->start();
+  }
 
   // Fill palette region in VRAM with default values
   int i = 0;
@@ -116,6 +223,17 @@ void ppu::start()
 
 void ppu::stop()
 {
+  if (renderWorker)
+  {
+    renderWorker->stop();
+    presentPendingFrame();
+  }
+
+  if (captureWriter)
+  {
+    captureWriter->stop();
+  }
+
   _renderer->cleanup();
 }
 
@@ -123,69 +241,202 @@ void ppu::reset()
 {
   scanline = SCANLINE_INIT;
   ppuCycles = 0;
+  spriteZeroHitDot = SPRITE_ZERO_NO_HIT;
+  syncedCycles = _scheduler->getCycles();
+  scheduleCatchUp();
+}
+
+void ppu::saveState(machine_state &state)
+{
+  catchUp();
+
+  std::vector<unsigned char> &registers = state.components[StateComponent::PpuRegisters];
+  registers.clear();
+  pushState(registers, ppu_control, 1);
+  pushState(registers, ppu_mask, 1);
+  pushState(registers, ppu_status, 1);
+  pushState(registers, sprite_address, 1);
+  pushState(registers, vram_address, 2);
+  pushState(registers, vram_latch, 2);
+  pushState(registers, scroll_x, 1);
+  pushState(registers, vram_access_flipflop, 1);
+  pushState(registers, vramDataLatch, 1);
+  pushState(registers, isVblank, 1);
+  pushState(registers, isNmiExecuted, 1);
+  pushState(registers, scanline, 2);
+  pushState(registers, ppuCycles, 2);
+
+  // Name tables, and the pattern tables too when they are RAM
+  std::vector<unsigned char> &vram = state.components[StateComponent::Vram];
+  vram.assign(video_memory + 0x2000, video_memory + 0x2000 + NAME_TABLE_COUNT * NAME_TABLE_BYTES);
+
+  if (hasChrRam)
+  {
+    pushState(vram, _mapper->getChrMemory(), CHR_BANKS * CHR_BANK_SIZE);
+  }
+
+  state.components[StateComponent::Oam].assign(sprite_memory, sprite_memory + SPRITE_RAM_SIZE);
+  state.components[StateComponent::Palette].assign(video_memory + ADDR_PALETTE_BG, video_memory + ADDR_PALETTE_BG + PALETTE_RAM_SIZE);
 }
 
-void ppu::execute(unsigned short cycles)
+// The PPU lags behind the CPU and only steps through the scanlines it missed
+// when something could observe or change its state: register access, writes
+// to mapper registers, and the VBlank and end of frame events it schedules.
+void ppu::catchUp()
 {
-  log();
+  if (!_scheduler || _scheduler->getCycles() == syncedCycles)
+  {
+    return;
+  }
 
-  // Calculate PPU cycles and scanline information
-  unsigned short ppuCyclesInstruction = cycles * PPU_PER_CPU_CYCLE;
-  ppuCycles += ppuCyclesInstruction;
+  unsigned long long dots = ppuCycles + (_scheduler->getCycles() - syncedCycles) * PPU_PER_CPU_CYCLE;
+  syncedCycles = _scheduler->getCycles();
 
-  if (ppuCycles >= PPU_PER_SCANLINE)
+  while (dots >= PPU_PER_SCANLINE)
   {
-    scanline += ppuCycles / PPU_PER_SCANLINE;
-    ppuCycles = ppuCycles % PPU_PER_SCANLINE;
+    dots -= PPU_PER_SCANLINE;
+    nextScanline();
   }
 
+  ppuCycles = dots;
+  checkNmi();
+}
+
+void ppu::checkNmi()
+{
+  if (isVblank &&
+    !isNmiExecuted &&
+    (ppu_control & PPU_CONTROL_NMI) &&
+    (ppu_status & PPU_STATUS_VBLANK_STARTED)
+   )
+   {
+     isNmiExecuted = true;
+     _cpu->enqueueInterrupt(Interrupt::Nmi);
+   }
+}
+
+// Wake up at the start of VBlank for the NMI, and at the end of the frame
+// to get it on screen. Mappers following unpredictable A12 rises need every
+// scanline on time.
+void ppu::scheduleCatchUp()
+{
+  unsigned short line = (scanline < SCANLINE_VBLANK_START) ? SCANLINE_VBLANK_START : SCANLINE_FRAME_END + 1;
+
+  if (!a12Observers.empty() && isRenderingEnabled() && a12RisesPerLine() == A12_UNPREDICTABLE)
+  {
+    line = scanline + 1;
+  }
+
+  unsigned int dots = (line - scanline) * PPU_PER_SCANLINE - ppuCycles;
+
+  _scheduler->schedule(SchedulerEvent::PpuCatchUp, syncedCycles + (dots + PPU_PER_CPU_CYCLE - 1) / PPU_PER_CPU_CYCLE);
+}
+
+bool ppu::isRenderingEnabled()
+{
+  return (ppu_mask & (PPU_MASK_SHOW_SPRITES | PPU_MASK_SHOW_BG)) != 0;
+}
+
+void ppu::nextScanline()
+{
+  // Let subscribed mappers see the pattern fetches of the finished scanline.
+  // Setups with a fixed number of rises per line are only counted, mappers
+  // predict those through cyclesUntilA12Rise().
+  if ((scanline <= SCANLINE_RENDER_END || scanline == SCANLINE_PRERENDER) &&
+    !a12Observers.empty() &&
+    isRenderingEnabled())
+  {
+    int rises = a12RisesPerLine();
+
+    if (rises == A12_UNPREDICTABLE)
+    {
+      clockA12(scanline);
+    }
+    else
+    {
+      a12Rises += rises;
+      settleA12(scanline);
+    }
+  }
+
+  scanline++;
+
+  // End of frame?
+  if (scanline > SCANLINE_FRAME_END)
+  {
+    ppu_status &= ~PPU_STATUS_SPRITE_OVERFLOW;
+    ppu_status &= ~PPU_STATUS_SPRITE_ZERO_HIT;
+    spriteZeroHitDot = SPRITE_ZERO_NO_HIT;
+
+    // Update screen
+    updateScreen();
+
+    transferLatch = false;
+    transferLatchScroll = false;
+    isNmiExecuted = false;
+    scanline = 0;
+    frameCount++;
+    startFrameLog();
+  }
+
+  startScanline();
+}
+
+// Only the state a scanline starts with is logged here. Pixels are drawn from
+// the log when the frame is done, the flags the CPU can see are still
+// computed right away.
+void ppu::startScanline()
+{
   // Rendering time (240 scanlines)?
   if (scanline >= SCANLINE_RENDER_START && scanline <= SCANLINE_RENDER_END)
   {
-    if (!transferLatch &&
-      ((ppu_mask & PPU_MASK_SHOW_SPRITES) || (ppu_mask & PPU_MASK_SHOW_BG))
-    )
+    if (isRenderingEnabled() && !transferLatch)
     {
       vram_address = vram_latch;
       transferLatch = true;
     }
 
-    if (scanline != previousScanline)
+    if (isFrameRequested)
     {
-      renderToBuffer();
-      previousScanline = scanline;
+      STATS_INC(renderedScanlines);
+      logScanline();
 
-      if ((ppu_mask & PPU_MASK_SHOW_SPRITES) || (ppu_mask & PPU_MASK_SHOW_BG)
-      )
+      // Mappers watching pattern fetches must see them as the scanline happens
+      if (!fetchWatches.empty())
       {
-        vram_address = (vram_address & (~0x1F & ~(1 << 10))) | (vram_latch & (0x1F | (1 << 10)));
-        _mapper->irqTick();
+        drawPendingLines();
       }
     }
+    else
+    {
+      STATS_INC(skippedScanlines);
+    }
+
+    if (!isRenderingEnabled())
+    {
+      return;
+    }
+
+    evaluateSpriteOverflow();
+    predictSpriteZeroHit();
+    incrementScrollY();
+    vram_address = (vram_address & (~0x1F & ~(1 << 10))) | (vram_latch & (0x1F | (1 << 10)));
   }
   // Start of vblank?
   else if (scanline == SCANLINE_VBLANK_START)
   {
+    // Draw the frame before VBlank writes change VRAM
+    if (isFrameRequested)
+    {
+      finishFrameLog();
+    }
+
     if (!isVblank)
     {
       isVblank = true;
       ppu_status |= PPU_STATUS_VBLANK_STARTED;
     }
   }
-  // End of frame?
-  else if (scanline > SCANLINE_FRAME_END)
-  {
-    ppu_status &= ~PPU_STATUS_SPRITE_OVERFLOW;
-    ppu_status &= ~PPU_STATUS_SPRITE_ZERO_HIT;
-
-    // Update screen
-    updateScreen();
-
-    transferLatch = false;
-    transferLatchScroll = false;
-    isNmiExecuted = false;
-    scanline = previousScanline = 0;
-  }
   // End of vblank?
   else if (scanline > SCANLINE_VBLANK_END)
   {
@@ -197,59 +448,580 @@ void ppu::execute(unsigned short cycles)
       //vram_address |= (vram_latch & 0x7BE0);
     }
   }
+}
 
-  if (isVblank &&
-    !isNmiExecuted &&
-    (ppu_control & PPU_CONTROL_NMI) &&
-    (ppu_status & PPU_STATUS_VBLANK_STARTED)
-   )
-   {
-     isNmiExecuted = true;
-     _cpu->enqueueInterrupt(Interrupt::Nmi);
-   }
+void ppu::startFrameLog()
+{
+  isFrameRequested = isFrameWanted();
+  frameLog->lineCount = 0;
+  frameLog->drawnLines = 0;
+  frameLog->paletteCount = 0;
+  frameLog->oamCount = 0;
+  frameLog->splitCount = 0;
+  paletteDirty = true;
+  oamDirty = true;
+  nameTablesDirty = true;
+  chrRamDirty = true;
+}
+
+bool ppu::isFrameWanted()
+{
+  // Mappers watching pattern fetches need every frame drawn
+  if (!fetchWatches.empty())
+  {
+    return true;
+  }
+
+  if (requestedFrames.count(frameCount + 1))
+  {
+    return true;
+  }
+
+  return (!_renderer->isHeadless() || captureWriter) && frameCount % Config::instance().renderInterval == 0;
+}
+
+void ppu::captureScanline(scanline_state &line)
+{
+  line.vramAddress = vram_address;
+  line.scrollX = scroll_x;
+  line.control = ppu_control;
+  line.mask = ppu_mask;
+  line.mirroring = _mapper->getMirroring();
+  memcpy(line.chrPages, chrPages, sizeof(line.chrPages));
+}
+
+void ppu::logScanline()
+{
+  scanline_state &line = frameLog->lines[scanline];
+  captureScanline(line);
+
+  if (paletteDirty)
+  {
+    memcpy(frameLog->palettes[frameLog->paletteCount++], video_memory + ADDR_PALETTE_BG, PALETTE_RAM_SIZE);
+    paletteDirty = false;
+  }
+
+  if (oamDirty)
+  {
+    memcpy(frameLog->oams[frameLog->oamCount++], sprite_memory, SPRITE_RAM_SIZE);
+    oamDirty = false;
+  }
+
+  line.palette = frameLog->paletteCount - 1;
+  line.oam = frameLog->oamCount - 1;
+  line.firstSplit = frameLog->splitCount;
+  line.splitCount = 0;
+  frameLog->lineCount = scanline + 1;
+}
+
+// Writes to $2000, $2001, $2005 and mapper registers in the middle of a
+// visible scanline change how the rest of it looks. The line is drawn with
+// the new state from the dot the write lands on, to the instruction.
+void ppu::splitScanline()
+{
+  if (isLineSplittable())
+  {
+    logSplit(ppuCycles ? ppuCycles - 1 : 0, currentLineState().vramAddress);
+  }
+}
+
+// Only the visible scanline being logged can be split, not one that is
+// drawn already because a mapper watches its pattern fetches
+bool ppu::isLineSplittable()
+{
+  return isFrameRequested &&
+    scanline <= SCANLINE_RENDER_END &&
+    ppuCycles <= SCREEN_WIDTH &&
+    frameLog->lineCount == scanline + 1 &&
+    frameLog->drawnLines <= scanline;
+}
+
+// Palette and OAM still change from one scanline to the next
+void ppu::logSplit(unsigned short x, unsigned short vramAddress)
+{
+  const scanline_state &current = currentLineState();
+  scanline_state state = current;
+
+  captureScanline(state);
+  state.vramAddress = vramAddress;
+
+  if (x >= SCREEN_WIDTH || frameLog->splitCount == FRAME_LOG_SPLITS)
+  {
+    return;
+  }
+
+  if (state.vramAddress == current.vramAddress &&
+    state.scrollX == current.scrollX &&
+    ((state.control ^ current.control) & PPU_CONTROL_RENDER_BITS) == 0 &&
+    state.mask == current.mask &&
+    state.mirroring == current.mirroring &&
+    memcmp(state.chrPages, current.chrPages, sizeof(state.chrPages)) == 0)
+  {
+    return;
+  }
+
+  scanline_split &split = frameLog->splits[frameLog->splitCount++];
+  split.x = x;
+  split.state = state;
+  frameLog->lines[scanline].splitCount++;
+}
+
+// The state the current scanline is drawn with at this point
+const scanline_state &ppu::currentLineState()
+{
+  const scanline_state &line = frameLog->lines[scanline];
+
+  if (line.splitCount)
+  {
+    return frameLog->splits[line.firstSplit + line.splitCount - 1].state;
+  }
+
+  return line;
+}
+
+// Copy the name tables and CHR RAM the pending lines are drawn from, so the
+// emulation can go on writing to them
+void ppu::snapshotMemory()
+{
+  if (nameTablesDirty)
+  {
+    memcpy(frameLog->nameTables, video_memory + 0x2000, sizeof(frameLog->nameTables));
+    memcpy(frameLog->attributes, attributeShadow, sizeof(frameLog->attributes));
+    nameTablesDirty = false;
+  }
+
+  if (!hasChrRam)
+  {
+    return;
+  }
+
+  unsigned char *chrMemory = _mapper->getChrMemory();
+
+  if (chrRamDirty)
+  {
+    memcpy(frameLog->chrRam, chrMemory, sizeof(frameLog->chrRam));
+    chrRamDirty = false;
+  }
+
+  for (unsigned short y = frameLog->drawnLines; y < frameLog->lineCount; y++)
+  {
+    scanline_state &line = frameLog->lines[y];
+    relocateChrRam(line, chrMemory);
+
+    for (int i = 0; i < line.splitCount; i++)
+    {
+      relocateChrRam(frameLog->splits[line.firstSplit + i].state, chrMemory);
+    }
+  }
+}
+
+// Point the CHR RAM pages of a logged state into the frame log's copy
+void ppu::relocateChrRam(scanline_state &line, unsigned char *chrMemory)
+{
+  for (int bank = 0; bank < CHR_BANKS; bank++)
+  {
+    unsigned char *&page = line.chrPages[bank];
+
+    if (page >= chrMemory && page < chrMemory + sizeof(frameLog->chrRam))
+    {
+      page = frameLog->chrRam + (page - chrMemory);
+    }
+  }
+}
+
+// Hand the logged frame over to be drawn
+void ppu::finishFrameLog()
+{
+  if (!renderWorker)
+  {
+    drawPendingLines();
+    return;
+  }
+
+  // The worker may still be drawing the previous frame out of the other log.
+  // It goes on screen once done, a frame after the non-threaded path.
+  renderWorker->wait();
+  presentPendingFrame();
+  snapshotMemory();
+  renderWorker->submit(frameLog);
+  isFramePending = true;
+
+  frameLog = (frameLog == &frameLogs[0]) ? &frameLogs[1] : &frameLogs[0];
+  frameLog->lineCount = 0;
+  frameLog->drawnLines = 0;
+  frameLog->splitCount = 0;
+}
+
+// Sets the overflow flag the way the sprite renderer used to: two passes over
+// OAM, background priority sprites first
+void ppu::evaluateSpriteOverflow()
+{
+  unsigned char spriteHeight = (ppu_control & PPU_CONTROL_SPRITE_SIZE) ? 16 : 8;
+  unsigned char backgroundPriority[] = { SPRITE_ATTR_BG_PRIO, 0 };
+
+  for (int pass = 0; pass < 2; pass++)
+  {
+    unsigned char spritesOnScanline = 0;
+
+    for (int spriteNum = SPRITE_FIRST_ENTRY; spriteNum >= 0; spriteNum -= SPRITE_ENTRY_SIZE)
+    {
+      unsigned char inRange = scanline - (sprite_memory[spriteNum] + 1);
+
+      if (sprite_memory[spriteNum] == 239)
+      {
+        ppu_status |= PPU_STATUS_SPRITE_OVERFLOW;
+      }
+      else if (sprite_memory[spriteNum] == 255)
+      {
+        ppu_status &= ~PPU_STATUS_SPRITE_OVERFLOW;
+      }
+
+      if (backgroundPriority[pass] != (sprite_memory[spriteNum + 2] & SPRITE_ATTR_BG_PRIO))
+      {
+        continue;
+      }
+
+      if (inRange < spriteHeight && spritesOnScanline++ >= SPRITE_OVERFLOW_COUNT)
+      {
+        ppu_status |= PPU_STATUS_SPRITE_OVERFLOW;
+      }
+    }
+  }
+}
+
+// Scroll Y increment (http://wiki.nesdev.com/w/index.php/The_skinny_on_NES_scrolling)
+void ppu::incrementScrollY()
+{
+  if ((vram_address & 0x7000) != 0x7000)
+  {
+    vram_address += 0x1000;
+  }
+  else
+  {
+    vram_address &= 0x0FFF;
+    unsigned short y = (vram_address & 0x03E0) >> 5;
+
+    if (y == 29)
+    {
+      y = 0;
+      vram_address ^= 0x0800;
+    }
+    else if (y == 31)
+    {
+      y = 0;
+    }
+    else
+    {
+      y++;
+    }
+
+    vram_address = (vram_address & ~0x03E0) | (y << 5);
+  }
+}
+
+void ppu::addA12Observer(PpuBusObserver *observer)
+{
+  a12Observers.push_back(observer);
+}
+
+void ppu::addFetchObserver(PpuBusObserver *observer, unsigned short low, unsigned short high)
+{
+  fetch_watch watch = { low, high, observer };
+  fetchWatches.push_back(watch);
+}
+
+// With 8x8 sprites A12 rises once per rendered scanline when background and
+// sprites use different pattern tables, and never when they share one
+int ppu::a12RisesPerLine()
+{
+  if (ppu_control & PPU_CONTROL_SPRITE_SIZE)
+  {
+    return A12_UNPREDICTABLE;
+  }
+
+  bool bgHigh = ppu_control & PPU_CONTROL_BG_PATTERN_ADDR;
+  bool spriteHigh = ppu_control & PPU_CONTROL_SPRITE_PATTERN_ADDR;
+  return (bgHigh != spriteHigh) ? 1 : 0;
+}
+
+// CPU cycles from now until A12 rise number `rise` (as counted by getA12Rises())
+// is seen, assuming the current setup holds. Rises are counted at the end of
+// the scanline they happen on.
+unsigned long long ppu::cyclesUntilA12Rise(unsigned long long rise)
+{
+  catchUp();
+
+  if (!isRenderingEnabled() || a12RisesPerLine() != 1)
+  {
+    return SCHEDULER_NEVER;
+  }
+
+  if (rise <= a12Rises)
+  {
+    return 0;
+  }
+
+  unsigned long long remaining = rise - a12Rises;
+  unsigned long long dots = PPU_PER_SCANLINE - ppuCycles;
+  unsigned short line = scanline;
+
+  while (true)
+  {
+    if ((line <= SCANLINE_RENDER_END || line == SCANLINE_PRERENDER) && --remaining == 0)
+    {
+      break;
+    }
+
+    dots += PPU_PER_SCANLINE;
+    line = (line == SCANLINE_FRAME_END) ? 0 : line + 1;
+  }
+
+  return (dots + PPU_PER_CPU_CYCLE - 1) / PPU_PER_CPU_CYCLE;
+}
+
+void ppu::notifyA12TimingChanged()
+{
+  for (std::vector<PpuBusObserver*>::iterator it = a12Observers.begin(); it != a12Observers.end(); ++it)
+  {
+    (*it)->a12TimingChanged();
+  }
+}
+
+// Replay the pattern table half of the fetches made during a scanline.
+// Every 8 dot group starts with name table/attribute fetches ($2xxx, A12 low)
+// followed by the two pattern planes: 32 background tiles, 8 sprite slots
+// and the first two background tiles of the next scanline.
+void ppu::clockA12(unsigned short line)
+{
+  bool bgHigh = ppu_control & PPU_CONTROL_BG_PATTERN_ADDR;
+  bool spriteHigh[SPRITE_SLOTS];
+  unsigned long long lineStart = (frameCount * (SCANLINE_FRAME_END + 1) + line) * PPU_PER_SCANLINE;
+
+  // 8x8 sprites all come from the same table, 8x16 sprites pick it by tile index.
+  // Unused slots fetch tile $FF.
+  for (int slot = 0; slot < SPRITE_SLOTS; slot++)
+  {
+    spriteHigh[slot] = (ppu_control & PPU_CONTROL_SPRITE_SIZE) ? true : (ppu_control & PPU_CONTROL_SPRITE_PATTERN_ADDR);
+  }
+
+  if (ppu_control & PPU_CONTROL_SPRITE_SIZE)
+  {
+    int slot = 0;
+    unsigned short nextLine = (line == SCANLINE_PRERENDER) ? 0 : line + 1;
+
+    for (int spriteNum = 0; spriteNum < SPRITE_RAM_SIZE && slot < SPRITE_SLOTS; spriteNum += SPRITE_ENTRY_SIZE)
+    {
+      unsigned char inRange = nextLine - (sprite_memory[spriteNum] + 1);
+
+      if (inRange < 16)
+      {
+        spriteHigh[slot++] = sprite_memory[spriteNum + 1] & 0x01;
+      }
+    }
+  }
+
+  for (int group = 0; group < FETCH_GROUPS_BG + SPRITE_SLOTS + FETCH_GROUPS_PREFETCH; group++)
+  {
+    bool patternHigh = bgHigh;
+
+    if (group >= FETCH_GROUPS_BG && group < FETCH_GROUPS_BG + SPRITE_SLOTS)
+    {
+      patternHigh = spriteHigh[group - FETCH_GROUPS_BG];
+    }
+
+    setA12(false, lineStart + group * FETCH_GROUP_DOTS);
+    setA12(patternHigh, lineStart + group * FETCH_GROUP_DOTS + FETCH_GROUP_DOTS / 2);
+  }
+
+  // Trailing name table fetches
+  setA12(false, lineStart + (FETCH_GROUPS_BG + SPRITE_SLOTS + FETCH_GROUPS_PREFETCH) * FETCH_GROUP_DOTS);
+}
+
+// Counted scanlines skip setA12(), leave A12 as clockA12() would have so
+// the filter is right when 8x16 sprites are switched on mid-frame. It goes
+// low for the last time after the background prefetch, or after the sprite
+// fetches when only sprites use the upper table.
+void ppu::settleA12(unsigned short line)
+{
+  unsigned long long lineStart = (frameCount * (SCANLINE_FRAME_END + 1) + line) * PPU_PER_SCANLINE;
+
+  if (ppu_control & PPU_CONTROL_BG_PATTERN_ADDR)
+  {
+    a12LowSince = lineStart + (FETCH_GROUPS_BG + SPRITE_SLOTS + FETCH_GROUPS_PREFETCH) * FETCH_GROUP_DOTS;
+  }
+  else if (ppu_control & PPU_CONTROL_SPRITE_PATTERN_ADDR)
+  {
+    a12LowSince = lineStart + (FETCH_GROUPS_BG + SPRITE_SLOTS) * FETCH_GROUP_DOTS;
+  }
+
+  a12High = false;
+}
+
+void ppu::setA12(bool high, unsigned long long dot)
+{
+  if (high && !a12High && dot - a12LowSince >= A12_FILTER_DOTS)
+  {
+    a12Rises++;
+
+    for (std::vector<PpuBusObserver*>::iterator it = a12Observers.begin(); it != a12Observers.end(); ++it)
+    {
+      (*it)->a12Rise();
+    }
+  }
+  else if (!high && a12High)
+  {
+    a12LowSince = dot;
+  }
+
+  a12High = high;
 }
 
 void ppu::log()
 {
   if (Config::instance().doInstructionLogging)
   {
+    catchUp();
     printf(" CYC:%3d SL:%d\n", ppuCycles, scanline);
   }
 }
 
-void ppu::renderToBuffer()
+// Draw the logged scanlines of the current frame that are still pending,
+// on the emulation thread
+void ppu::drawPendingLines()
 {
-  if ((ppu_mask & (PPU_MASK_SHOW_SPRITES | PPU_MASK_SHOW_BG)) == 0)
+  if (frameLog->drawnLines == frameLog->lineCount)
   {
     return;
   }
 
-  renderSprites(SPRITE_ATTR_BG_PRIO);
-  renderBackground();
-  renderSprites();
+  // The renderer may still be busy with the previous frame, which has to be
+  // on screen before this one is drawn over it
+  if (renderWorker)
+  {
+    renderWorker->wait();
+    presentPendingFrame();
+  }
+
+  snapshotMemory();
+  drawLoggedLines(*frameLog);
 }
 
-void ppu::renderSprites(unsigned char backgroundPriority)
+// Draw the logged scanlines that haven't been drawn yet
+void ppu::drawLoggedLines(frame_log &log)
 {
-  if (ppu_control & PPU_CONTROL_SPRITE_SIZE)
+  for (; log.drawnLines < log.lineCount; log.drawnLines++)
   {
-    renderTile8x16(backgroundPriority);
+    if (log.drawnLines == 0)
+    {
+      paletteCacheSnapshot = PALETTE_SNAPSHOT_NONE;
+    }
+
+    drawScanline(log, log.drawnLines);
+  }
+}
+
+// Draw one scanline of the frame buffer, and the parts of it changed by
+// writes in the middle of the line
+void ppu::drawScanline(const frame_log &log, unsigned short y)
+{
+  const scanline_state &line = log.lines[y];
+  unsigned short *output = frameBuffer + y * SCREEN_WIDTH;
+
+  composeScanline(log, line, y, output);
+
+  for (int i = 0; i < line.splitCount; i++)
+  {
+    const scanline_split &split = log.splits[line.firstSplit + i];
+    unsigned short splitPixels[SCREEN_WIDTH];
+
+    composeScanline(log, split.state, y, splitPixels);
+    memcpy(output + split.x, splitPixels + split.x, (SCREEN_WIDTH - split.x) * sizeof(unsigned short));
+  }
+}
+
+// Composite a scanline drawn with the given state from the background and
+// sprite line buffers
+void ppu::composeScanline(const frame_log &log, const scanline_state &line, unsigned short y, unsigned short *output)
+{
+  unsigned char bgPixels[SCREEN_WIDTH];
+  unsigned char spritePixels[SCREEN_WIDTH];
+  unsigned long long bgOpaque[OPAQUE_MASK_WORDS];
+
+  resolvePalette(log, line);
+
+  // Rendering disabled => backdrop color
+  if ((line.mask & (PPU_MASK_SHOW_SPRITES | PPU_MASK_SHOW_BG)) == 0)
+  {
+    for (int x = 0; x < SCREEN_WIDTH; x++)
+    {
+      output[x] = paletteCache[0];
+    }
+
+    return;
+  }
+
+  memset(bgOpaque, 0, sizeof(bgOpaque));
+  memset(spritePixels, 0, sizeof(spritePixels));
+
+  if (line.mask & PPU_MASK_SHOW_BG)
+  {
+    renderBackground(line, log.nameTables, log.attributes, bgPixels, bgOpaque);
+
+    if (!(line.mask & PPU_MASK_BG_LEFT))
+    {
+      bgOpaque[0] &= ~((1ULL << TILE_WIDTH) - 1);
+    }
+  }
+
+  if (line.mask & PPU_MASK_SHOW_SPRITES)
+  {
+    renderSprites(log, line, y, spritePixels);
+
+    if (!(line.mask & PPU_MASK_SPRITE_LEFT))
+    {
+      memset(spritePixels, 0, TILE_WIDTH);
+    }
+  }
+
+  // The frontmost opaque sprite pixel shows unless it is behind an opaque
+  // background pixel, transparent background pixels show the backdrop
+  for (int x = 0; x < SCREEN_WIDTH; x++)
+  {
+    bool bgIsOpaque = isOpaque(bgOpaque, x);
+    unsigned char spritePixel = spritePixels[x];
+
+    if ((spritePixel & 0x03) && (!bgIsOpaque || !(spritePixel & SPRITE_ATTR_BG_PRIO)))
+    {
+      output[x] = paletteCache[PALETTE_SPRITE_OFFSET | (spritePixel & 0x0F)];
+    }
+    else
+    {
+      output[x] = paletteCache[bgIsOpaque ? bgPixels[x] : 0];
+    }
+  }
+}
+
+// Frontmost opaque sprite pixel per x: palette index plus the background priority bit
+void ppu::renderSprites(const frame_log &log, const scanline_state &line, unsigned short y, unsigned char *spritePixels)
+{
+  if (line.control & PPU_CONTROL_SPRITE_SIZE)
+  {
+    renderTile8x16(log, line, y, spritePixels);
   }
   else
   {
-    renderTile8x8(backgroundPriority);
+    renderTile8x8(log, line, y, spritePixels);
   }
 }
 
-void ppu::renderTile8x8(unsigned char backgroundPriority)
+void ppu::renderTile8x8(const frame_log &log, const scanline_state &line, unsigned short y, unsigned char *spritePixels)
 {
   unsigned short patternTableAddr;
   unsigned char patternPlane1, patternPlane2, paletteIndex, paletteUpperBits;
   unsigned char inRange, spriteX, spriteY, tileIndex, spriteAttribute;
+  const unsigned char *oam = log.oams[line.oam];
 
-  spritesOnScanline = 0;
-
-  if (ppu_control & PPU_CONTROL_SPRITE_PATTERN_ADDR)
+  if (line.control & PPU_CONTROL_SPRITE_PATTERN_ADDR)
   {
     patternTableAddr = ADDR_PATTERN_TABLE1;
   }
@@ -261,37 +1033,16 @@ void ppu::renderTile8x8(unsigned char backgroundPriority)
   // Iterate through sprites (lowest priority first)
   for (int spriteNum = SPRITE_FIRST_ENTRY; spriteNum >= 0; spriteNum -= SPRITE_ENTRY_SIZE)
   {
-    tileIndex = sprite_memory[spriteNum + 1];
-    spriteAttribute = sprite_memory[spriteNum + 2];
-    spriteX = sprite_memory[spriteNum + 3];
-    spriteY = sprite_memory[spriteNum] + 1;
-
-    if (sprite_memory[spriteNum] == 239)
-    {
-      ppu_status |= PPU_STATUS_SPRITE_OVERFLOW;
-    }
-    else if (sprite_memory[spriteNum] == 255)
-    {
-      ppu_status &= ~PPU_STATUS_SPRITE_OVERFLOW;
-    }
-
-    // Skip sprite if other priority
-    if (backgroundPriority != (spriteAttribute & SPRITE_ATTR_BG_PRIO))
-    {
-      continue;
-    }
+    tileIndex = oam[spriteNum + 1];
+    spriteAttribute = oam[spriteNum + 2];
+    spriteX = oam[spriteNum + 3];
+    spriteY = oam[spriteNum] + 1;
 
     // Is the sprite positioned within the current scanline?
-    inRange = scanline - spriteY;
+    inRange = y - spriteY;
 
     if (inRange < 8)
     {
-      // Sprite overflow?
-      if (spritesOnScanline++ >= SPRITE_OVERFLOW_COUNT)
-      {
-        ppu_status |= PPU_STATUS_SPRITE_OVERFLOW;
-      }
-
       // Flip vertically?
       if (spriteAttribute & SPRITE_ATTR_VERTICAL_FLIP)
       {
@@ -299,11 +1050,11 @@ void ppu::renderTile8x8(unsigned char backgroundPriority)
       }
 
       // Get pattern data
-      patternPlane1 = read(patternTableAddr + (tileIndex << 4) + inRange);
-      patternPlane2 = read(patternTableAddr + (tileIndex << 4) + inRange + 8);
+      patternPlane1 = readPattern(line, patternTableAddr + (tileIndex << 4) + inRange);
+      patternPlane2 = readPattern(line, patternTableAddr + (tileIndex << 4) + inRange + 8);
       paletteUpperBits = (spriteAttribute & SPRITE_ATTR_COLOR) << 2;
 
-      for (int pixelNum = 0; pixelNum < TILE_WIDTH; pixelNum++)
+      for (int pixelNum = 0; pixelNum < TILE_WIDTH && spriteX + pixelNum < SCREEN_WIDTH; pixelNum++)
       {
         paletteIndex = paletteUpperBits;
 
@@ -320,23 +1071,9 @@ void ppu::renderTile8x8(unsigned char backgroundPriority)
         }
 
         // If color bits from pattern tables are zero => transparent pixel
-        if ((paletteIndex & 0x3) == 0)
-        {
-          //setTransparentPixel(backgroundPriority ? sprBg : sprFg, spriteX + pixelNum, scanline);
-        }
-        else
+        if ((paletteIndex & 0x3) != 0)
         {
-          if (spriteNum == SPRITE_ZERO &&
-            (ppu_mask & PPU_MASK_SHOW_SPRITES) &&
-            (ppu_mask & PPU_MASK_SHOW_BG))
-          {
-            if (!_renderer->isTransparentPixel(spriteX + pixelNum, scanline))
-            {
-              ppu_status |= PPU_STATUS_SPRITE_ZERO_HIT;
-            }
-          }
-
-          _renderer->setPixel(backgroundPriority ? PixelType::BackgroundSprite : PixelType::ForegroundSprite, spriteX + pixelNum, scanline, palette_table[read(ADDR_PALETTE_SPRITE + paletteIndex)]);
+          spritePixels[spriteX + pixelNum] = paletteIndex | (spriteAttribute & SPRITE_ATTR_BG_PRIO);
         }
       }
     }
@@ -344,45 +1081,29 @@ void ppu::renderTile8x8(unsigned char backgroundPriority)
 }
 
 // Based on 8x16 rendering from My Nes
-void ppu::renderTile8x16(unsigned char backgroundPriority)
+void ppu::renderTile8x16(const frame_log &log, const scanline_state &line, unsigned short y, unsigned char *spritePixels)
 {
   unsigned short patternTableAddr;
   unsigned char patternPlane1, patternPlane2, paletteIndex, paletteUpperBits;
   unsigned char inRange, spriteX, spriteY, tileIndex, spriteAttribute;
-
-  spritesOnScanline = 0;
+  const unsigned char *oam = log.oams[line.oam];
 
   // Iterate through sprites (lowest priority first)
   for (int spriteNum = SPRITE_FIRST_ENTRY; spriteNum >= 0; spriteNum -= SPRITE_ENTRY_SIZE)
   {
-    tileIndex = sprite_memory[spriteNum + 1];
-    spriteAttribute = sprite_memory[spriteNum + 2];
-    spriteX = sprite_memory[spriteNum + 3];
-    spriteY = sprite_memory[spriteNum] + 1;
+    tileIndex = oam[spriteNum + 1];
+    spriteAttribute = oam[spriteNum + 2];
+    spriteX = oam[spriteNum + 3];
+    spriteY = oam[spriteNum] + 1;
     int spriteId = tileIndex;
 
-    if (sprite_memory[spriteNum] == 239)
-    {
-      ppu_status |= PPU_STATUS_SPRITE_OVERFLOW;
-    }
-    else if (sprite_memory[spriteNum] == 255)
-    {
-      ppu_status &= ~PPU_STATUS_SPRITE_OVERFLOW;
-    }
-
-    // Skip sprite if other priority
-    if (backgroundPriority != (spriteAttribute & SPRITE_ATTR_BG_PRIO))
-    {
-      continue;
-    }
-
     // Is the sprite positioned within the current scanline?
-    inRange = scanline - spriteY;
+    inRange = y - spriteY;
 
     // Flip vertically?
     if (spriteAttribute & SPRITE_ATTR_VERTICAL_FLIP)
     {
-      inRange = spriteY + 15 - scanline;
+      inRange = spriteY + 15 - y;
     }
 
     if (inRange < 16)
@@ -406,7 +1127,6 @@ void ppu::renderTile8x16(unsigned char backgroundPriority)
         if (spriteId % 2 == 0)
         {
           patternTableAddr = 0x0000;
-          tileIndex += 1;
         }
         else
         {
@@ -416,11 +1136,11 @@ void ppu::renderTile8x16(unsigned char backgroundPriority)
       }
 
       // Get pattern data
-      patternPlane1 = read(patternTableAddr + (tileIndex << 4) + inRange);
-      patternPlane2 = read(patternTableAddr + (tileIndex << 4) + inRange + 8);
+      patternPlane1 = readPattern(line, patternTableAddr + (tileIndex << 4) + inRange);
+      patternPlane2 = readPattern(line, patternTableAddr + (tileIndex << 4) + inRange + 8);
       paletteUpperBits = (spriteAttribute & SPRITE_ATTR_COLOR) << 2;
 
-      for (int pixelNum = 0; pixelNum < TILE_WIDTH; pixelNum++)
+      for (int pixelNum = 0; pixelNum < TILE_WIDTH && spriteX + pixelNum < SCREEN_WIDTH; pixelNum++)
       {
         paletteIndex = paletteUpperBits;
 
@@ -437,154 +1157,265 @@ void ppu::renderTile8x16(unsigned char backgroundPriority)
         }
 
         // If color bits from pattern tables are zero => transparent pixel
-        if ((paletteIndex & 0x3) == 0)
-        {
-          //setTransparentPixel(backgroundPriority ? sprBg : sprFg, spriteX + pixelNum, scanline);
-        }
-        else
+        if ((paletteIndex & 0x3) != 0)
         {
-          if (spriteNum == SPRITE_ZERO &&
-            (ppu_mask & PPU_MASK_SHOW_SPRITES) &&
-            (ppu_mask & PPU_MASK_SHOW_BG))
-          {
-            if (!_renderer->isTransparentPixel(spriteX + pixelNum, scanline))
-            {
-              ppu_status |= PPU_STATUS_SPRITE_ZERO_HIT;
-            }
-          }
-
-          _renderer->setPixel(backgroundPriority ? PixelType::BackgroundSprite : PixelType::ForegroundSprite, spriteX + pixelNum, scanline, palette_table[read(ADDR_PALETTE_SPRITE + paletteIndex)]);
+          spritePixels[spriteX + pixelNum] = paletteIndex | (spriteAttribute & SPRITE_ATTR_BG_PRIO);
         }
       }
     }
   }
 }
 
-void ppu::renderBackground()
+// Find the first dot of the current scanline where an opaque pixel of
+// sprite 0 meets an opaque background pixel. $2002 reads compare against it.
+void ppu::predictSpriteZeroHit()
 {
-  unsigned short nameTableAddr, patternTableAddr, attributeTableAddr, tileAddress, attributeAddress;
-  unsigned char attributeValue, tileIndex, groupIndex, paletteIndex;
-  unsigned char patternPlane1, patternPlane2, paletteUpperBits;
-  unsigned char tileX, tileY, tileScrollY, tileScrollX;
+  unsigned short patternTableAddr;
+  unsigned char patternPlane1, patternPlane2, pixelBit;
+  unsigned long long spriteOpaque[OPAQUE_MASK_WORDS];
+  unsigned long long bgOpaque[OPAQUE_MASK_WORDS];
+  unsigned char tileIndex = sprite_memory[SPRITE_ZERO + 1];
+  unsigned char spriteAttribute = sprite_memory[SPRITE_ZERO + 2];
+  unsigned char spriteX = sprite_memory[SPRITE_ZERO + 3];
+  unsigned char spriteHeight = (ppu_control & PPU_CONTROL_SPRITE_SIZE) ? 16 : 8;
+  unsigned char inRange = scanline - (sprite_memory[SPRITE_ZERO] + 1);
+
+  if (spriteZeroHitDot != SPRITE_ZERO_NO_HIT ||
+    (ppu_mask & (PPU_MASK_SHOW_SPRITES | PPU_MASK_SHOW_BG)) != (PPU_MASK_SHOW_SPRITES | PPU_MASK_SHOW_BG) ||
+    inRange >= spriteHeight)
+  {
+    return;
+  }
 
-  // Select base address for pattern table
-  if (ppu_control & PPU_CONTROL_BG_PATTERN_ADDR)
+  if (spriteAttribute & SPRITE_ATTR_VERTICAL_FLIP)
+  {
+    inRange = spriteHeight - 1 - inRange;
+  }
+
+  // 8x16 sprites take the pattern table from bit 0 of the tile index
+  if (spriteHeight == 16)
   {
-    patternTableAddr = 0x1000;
+    patternTableAddr = (tileIndex & 0x01) ? ADDR_PATTERN_TABLE1 : ADDR_PATTERN_TABLE0;
+    tileIndex &= ~0x01;
+
+    if (inRange >= 8)
+    {
+      tileIndex++;
+      inRange -= 8;
+    }
   }
   else
   {
-    patternTableAddr = 0x0000;
+    patternTableAddr = (ppu_control & PPU_CONTROL_SPRITE_PATTERN_ADDR) ? ADDR_PATTERN_TABLE1 : ADDR_PATTERN_TABLE0;
   }
 
-  // Iterate through tiles in name table
-  for (int tileNum = 0; tileNum < NAME_TABLE_WIDTH; tileNum++)
+  patternPlane1 = peekChr(patternTableAddr + (tileIndex << 4) + inRange);
+  patternPlane2 = peekChr(patternTableAddr + (tileIndex << 4) + inRange + 8);
+
+  memset(spriteOpaque, 0, sizeof(spriteOpaque));
+
+  // Opaque sprite pixels, in the same mask layout as the background
+  for (int pixelNum = 0; pixelNum < TILE_WIDTH; pixelNum++)
   {
-    switch ((vram_address >> 10) & 0x03)
+    int x = spriteX + pixelNum;
+    pixelBit = (spriteAttribute & SPRITE_ATTR_HORIZONTAL_FLIP) ? (0x01 << pixelNum) : (0x80 >> pixelNum);
+
+    // No hit at x = 255 or in a clipped left column
+    if (x >= SCREEN_WIDTH - 1 ||
+      (x < 8 && (ppu_mask & (PPU_MASK_BG_LEFT | PPU_MASK_SPRITE_LEFT)) != (PPU_MASK_BG_LEFT | PPU_MASK_SPRITE_LEFT)))
     {
-      case 0: nameTableAddr = 0x2000; break;
-      case 1: nameTableAddr = 0x2400; break;
-      case 2: nameTableAddr = 0x2800; break;
-      case 3: nameTableAddr = 0x2C00; break;
+      continue;
     }
 
-    attributeTableAddr = nameTableAddr + 0x03C0;
-    tileX = vram_address & 0x1F;
-    tileY = (vram_address >> 5) & 0x1F;
-    tileScrollY = (vram_address >> 12) & 0x07;
-    tileScrollX = scroll_x;
-    tileAddress = nameTableAddr | (vram_address & 0x03FF);
-
-    // Iterate through pixels in tile
-    for (int pixelNum = 0; pixelNum < TILE_WIDTH; pixelNum++)
+    if ((patternPlane1 | patternPlane2) & pixelBit)
     {
-      // Get pattern data
-      tileIndex = read(tileAddress);
-      patternPlane1 = read(patternTableAddr + (tileIndex << 4) + tileScrollY);
-      patternPlane2 = read(patternTableAddr + (tileIndex << 4) + tileScrollY + 8);
-
-      // Get attribute data
-      //attributeAddress = attributeTableAddr | (vram_address & 0x0C00) | ((vram_address >> 4) & 0x38) | ((vram_address >> 2) & 0x07);
-      attributeAddress = attributeTableAddr | ( ((((tileY * TILE_WIDTH) + tileScrollY) / 32) * (SCREEN_WIDTH / 32)) + (((tileX * TILE_WIDTH) + tileScrollX) / 32) );
-      attributeValue = read(attributeAddress);
-      groupIndex = (((tileX % 4) & 0x2) >> 1) + ((tileY % 4) & 0x2);
-      paletteUpperBits = ((attributeValue >> (groupIndex<<1)) & 0x3) << 2;
-
-      // Get color bits
-      paletteIndex = paletteUpperBits;
-      paletteIndex |= patternPlane1 & (0x80 >> tileScrollX) ? 0x1 : 0;
-      paletteIndex |= patternPlane2 & (0x80 >> tileScrollX) ? 0x2 : 0;
-
-      // If color bits from pattern tables are zero => transparent pixel
-      if ((paletteIndex & 0x3) == 0)
-      {
-        _renderer->setTransparentPixel((tileNum << 3) + pixelNum, scanline);
-      }
-      else
-      {
-        // Render pixel to buffer
-        _renderer->setPixel(PixelType::BackgroundTile, (tileNum << 3) + pixelNum, scanline, palette_table[read(ADDR_PALETTE_BG + paletteIndex)]);
-      }
+      spriteOpaque[x >> 6] |= 1ULL << (x & 63);
+    }
+  }
 
-      // Update fine X for this tile
-      tileScrollX++;
+  peekBackgroundMask(bgOpaque);
+  int x = firstOpaqueOverlap(spriteOpaque, bgOpaque);
 
-      // Wrap to beginning of tile
-      if (tileScrollX >= TILE_WIDTH)
-      {
-        tileScrollX = 0;
-        tileAddress++;
-        tileX++;
+  if (x != OPAQUE_NO_OVERLAP)
+  {
+    // Pixel x is output at dot x + 1
+    spriteZeroHitDot = scanline * PPU_PER_SCANLINE + x + 1;
+  }
+}
 
-        // Wrap name table horizontally
-        if ((tileAddress & 0x1F) == 0)
-        {
-          tileAddress--;
-          tileX--;
-          tileAddress &= ~0x001F;
-          tileAddress ^= 0x0400;
-        }
-      }
-    }
+// Opaque background pixels of the current scanline, fetched the way
+// renderBackground() does but straight from the CHR pages. Mappers watching
+// pattern fetches must not see them.
+void ppu::peekBackgroundMask(unsigned long long *opaque)
+{
+  unsigned short patternTableAddr = (ppu_control & PPU_CONTROL_BG_PATTERN_ADDR) ? ADDR_PATTERN_TABLE1 : ADDR_PATTERN_TABLE0;
+  unsigned short fetchAddress = vram_address;
+  unsigned char tileScrollY = (vram_address >> 12) & 0x07;
+  unsigned char tilePixels[NAME_TABLE_WIDTH + 1];
+  enum Mirroring mirroring = _mapper->getMirroring();
+  int tiles = scroll_x ? NAME_TABLE_WIDTH + 1 : NAME_TABLE_WIDTH;
+
+  for (int tileNum = 0; tileNum < tiles; tileNum++)
+  {
+    unsigned short tileAddress = mirrorNameTables(0x2000 | (fetchAddress & 0x0FFF), mirroring);
+    unsigned short address = patternTableAddr + (video_memory[0x2000 + (tileAddress & 0x0FFF)] << 4) + tileScrollY;
+    tilePixels[tileNum] = peekChr(address) | peekChr(address + 8);
 
-    // Scroll X increment (http://wiki.nesdev.com/w/index.php/The_skinny_on_NES_scrolling)
-    if ((vram_address & 0x001F) == 31)
+    if ((fetchAddress & 0x001F) == 31)
     {
-      vram_address &= ~0x001F;
-      vram_address ^= 0x0400;
+      fetchAddress &= ~0x001F;
+      fetchAddress ^= 0x0400;
     }
     else
     {
-      vram_address++;
+      fetchAddress++;
     }
   }
 
-  // Scroll Y increment (http://wiki.nesdev.com/w/index.php/The_skinny_on_NES_scrolling)
-  if ((vram_address & 0x7000) != 0x7000)
+  fillOpaqueMask(tilePixels, tiles, scroll_x, opaque);
+}
+
+// One bit per opaque pixel of a scanline, bit x & 63 of word x >> 6. Built
+// from the or'ed pattern planes of the tiles it touches, the first one
+// starting fineX pixels left of the screen.
+void ppu::fillOpaqueMask(const unsigned char *tilePixels, int tiles, unsigned char fineX, unsigned long long *opaque)
+{
+  memset(opaque, 0, OPAQUE_MASK_WORDS * sizeof(unsigned long long));
+
+  for (int tileNum = 0; tileNum < tiles; tileNum++)
   {
-    vram_address += 0x1000;
+    unsigned long long bits = patternReverse[tilePixels[tileNum]];
+    int x = tileNum * TILE_WIDTH - fineX;
+
+    if (x < 0)
+    {
+      bits >>= -x;
+      x = 0;
+    }
+
+    opaque[x >> 6] |= bits << (x & 63);
+
+    // Tile split over two words
+    if ((x & 63) > 64 - TILE_WIDTH && (x >> 6) + 1 < OPAQUE_MASK_WORDS)
+    {
+      opaque[(x >> 6) + 1] |= bits >> (64 - (x & 63));
+    }
   }
-  else
+}
+
+// First x both masks have an opaque pixel at
+int ppu::firstOpaqueOverlap(const unsigned long long *a, const unsigned long long *b)
+{
+  for (int word = 0; word < OPAQUE_MASK_WORDS; word++)
   {
-    vram_address &= 0x0FFF;
-    unsigned short y = (vram_address & 0x03E0) >> 5;
+    unsigned long long overlap = a[word] & b[word];
 
-    if (y == 29)
+    if (overlap)
     {
-      y = 0;
-      vram_address ^= 0x0800;
+      return word * 64 + __builtin_ctzll(overlap);
     }
-    else if (y == 31)
+  }
+
+  return OPAQUE_NO_OVERLAP;
+}
+
+// Palette indices of the background pixels of a scanline, fetched from the
+// given name and attribute tables, and the mask of the opaque ones.
+void ppu::renderBackground(
+  const scanline_state &line,
+  const unsigned char *nameTables,
+  const unsigned char (*attributes)[NAME_TABLE_WIDTH][NAME_TABLE_WIDTH],
+  unsigned char *pixels,
+  unsigned long long *opaque)
+{
+  unsigned short patternTableAddr, fetchAddress, tileAddress;
+  unsigned char tileIndex;
+  unsigned char tileScrollY = (line.vramAddress >> 12) & 0x07;
+  unsigned char patternPlanes1[NAME_TABLE_WIDTH + 1];
+  unsigned char patternPlanes2[NAME_TABLE_WIDTH + 1];
+  unsigned char paletteUpperBits[NAME_TABLE_WIDTH + 1];
+  unsigned char tilePixels[NAME_TABLE_WIDTH + 1];
+  unsigned char lineBuffer[(NAME_TABLE_WIDTH + 1) * TILE_WIDTH];
+
+  // Fine X scrolling makes the scanline touch one more tile
+  int tiles = line.scrollX ? NAME_TABLE_WIDTH + 1 : NAME_TABLE_WIDTH;
+  int tileNum = 0;
+
+  // Select base address for pattern table
+  if (line.control & PPU_CONTROL_BG_PATTERN_ADDR)
+  {
+    patternTableAddr = ADDR_PATTERN_TABLE1;
+  }
+  else
+  {
+    patternTableAddr = ADDR_PATTERN_TABLE0;
+  }
+
+  // Fetch name table, attribute and pattern data once per tile
+  for (fetchAddress = line.vramAddress; tileNum < tiles; tileNum++)
+  {
+    tileAddress = mirrorNameTables(0x2000 | (fetchAddress & 0x0FFF), line.mirroring);
+    tileIndex = nameTables[tileAddress & 0x0FFF];
+    paletteUpperBits[tileNum] = attributes[(tileAddress >> 10) & 0x03][(fetchAddress >> 5) & 0x1F][fetchAddress & 0x1F];
+    patternPlanes1[tileNum] = readPattern(line, patternTableAddr + (tileIndex << 4) + tileScrollY);
+    patternPlanes2[tileNum] = readPattern(line, patternTableAddr + (tileIndex << 4) + tileScrollY + 8);
+    tilePixels[tileNum] = patternPlanes1[tileNum] | patternPlanes2[tileNum];
+
+    // Scroll X increment (http://wiki.nesdev.com/w/index.php/The_skinny_on_NES_scrolling)
+    if ((fetchAddress & 0x001F) == 31)
     {
-      y = 0;
+      fetchAddress &= ~0x001F;
+      fetchAddress ^= 0x0400;
     }
     else
     {
-      y++;
+      fetchAddress++;
     }
+  }
 
-    vram_address = (vram_address & ~0x03E0) | (y << 5);
+  // Interleave the two bit planes into one palette index per pixel
+  tileNum = 0;
+
+#ifdef __SSE2__
+  const __m128i pixelBits = _mm_set_epi8(
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80);
+
+  // Two tiles per iteration, every plane byte is broadcast over its 8 pixels
+  for (; tileNum + 1 < tiles; tileNum += 2)
+  {
+    __m128i plane1 = _mm_set_epi64x(
+      patternPlanes1[tileNum + 1] * PATTERN_BYTE_BROADCAST,
+      patternPlanes1[tileNum] * PATTERN_BYTE_BROADCAST);
+    __m128i plane2 = _mm_set_epi64x(
+      patternPlanes2[tileNum + 1] * PATTERN_BYTE_BROADCAST,
+      patternPlanes2[tileNum] * PATTERN_BYTE_BROADCAST);
+    __m128i upperBits = _mm_set_epi64x(
+      paletteUpperBits[tileNum + 1] * PATTERN_BYTE_BROADCAST,
+      paletteUpperBits[tileNum] * PATTERN_BYTE_BROADCAST);
+
+    plane1 = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(plane1, pixelBits), pixelBits), _mm_set1_epi8(0x01));
+    plane2 = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(plane2, pixelBits), pixelBits), _mm_set1_epi8(0x02));
+
+    _mm_storeu_si128(
+      (__m128i*)(lineBuffer + tileNum * TILE_WIDTH),
+      _mm_or_si128(_mm_or_si128(plane1, plane2), upperBits));
+  }
+#endif
+
+  for (; tileNum < tiles; tileNum++)
+  {
+    unsigned long long tilePixels =
+      patternSpread[patternPlanes1[tileNum]] |
+      (patternSpread[patternPlanes2[tileNum]] << 1) |
+      (paletteUpperBits[tileNum] * PATTERN_BYTE_BROADCAST);
+
+    memcpy(lineBuffer + tileNum * TILE_WIDTH, &tilePixels, TILE_WIDTH);
   }
+
+  // Fine X scrolling is a shifted copy out of the line buffer
+  memcpy(pixels, lineBuffer + line.scrollX, SCREEN_WIDTH);
+  fillOpaqueMask(tilePixels, tiles, line.scrollX, opaque);
 }
 
 void ppu::updateScreen()
@@ -592,25 +1423,59 @@ void ppu::updateScreen()
   clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
   diff = utils::timespecDiff(&lastScreenUpdate, &now);
 
-  // If last updateScreen() happens faster than 60 Hz then sleep for a while
-  if (diff.tv_sec == 0 && diff.tv_nsec < SCREEN_UPDATE_TIME_IN_NS)
+  // If last updateScreen() happens faster than 60 Hz then sleep for a while,
+  // unless there is no screen to pace
+  if (_renderer->isPaced() && diff.tv_sec == 0 && diff.tv_nsec < SCREEN_UPDATE_TIME_IN_NS)
   {
     diff.tv_nsec = SCREEN_UPDATE_TIME_IN_NS - diff.tv_nsec;
     nanosleep(NULL, &diff);
   }
 
-  // Update screen
-  _renderer->update();
-
-  // Clear screen
-  palette_entry entry = palette_table[read(ADDR_PALETTE_BG)];
-  _renderer->clear(entry);
+  // Frames drawn by the render worker are presented at the next hand over
+  if (isFrameRequested && !renderWorker)
+  {
+    presentFrame();
+  }
 
   clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &lastScreenUpdate);
 }
 
+void ppu::presentFrame()
+{
+  _renderer->update(frameBuffer);
+
+  if (captureWriter)
+  {
+    captureWriter->submit(frameBuffer);
+  }
+}
+
+// The render worker may still be drawing into the frame buffer
+void ppu::waitForFrame()
+{
+  if (renderWorker)
+  {
+    renderWorker->wait();
+  }
+}
+
+// Only call once the render worker is done with the frame
+void ppu::presentPendingFrame()
+{
+  if (isFramePending)
+  {
+    presentFrame();
+    isFramePending = false;
+  }
+}
+
 unsigned char ppu::read(unsigned short address)
 {
+  if (address < 0x2000)
+  {
+    return readChr(address);
+  }
+
   unsigned short tmp = vram_address;
   vram_address = address;
   unsigned char value = read();
@@ -622,15 +1487,40 @@ unsigned char ppu::read()
 {
   if (vram_address < 0x2000)
   {
-    unsigned char value;
-    _mapper->readChrRom(vram_address, value);
-    return value;
+    return readChr(vram_address);
   }
 
   unsigned short address = normalizeAddress(vram_address);
   return video_memory[address];
 }
 
+unsigned char ppu::readChr(unsigned short address)
+{
+  unsigned char value = chrPages[address >> 10][address & 0x03FF];
+  notifyFetch(address);
+  return value;
+}
+
+// Pattern fetch through the CHR banks a logged scanline started with
+unsigned char ppu::readPattern(const scanline_state &line, unsigned short address)
+{
+  unsigned char value = line.chrPages[address >> 10][address & 0x03FF];
+  notifyFetch(address);
+  return value;
+}
+
+// Tell subscribed mappers (e.g. MMC2 latches) about fetches they watch
+void ppu::notifyFetch(unsigned short address)
+{
+  for (std::vector<fetch_watch>::iterator it = fetchWatches.begin(); it != fetchWatches.end(); ++it)
+  {
+    if (address >= it->low && address <= it->high)
+    {
+      it->observer->watchedFetch(address);
+    }
+  }
+}
+
 void ppu::write(unsigned short address, unsigned char value)
 {
   unsigned short tmp = vram_address;
@@ -641,20 +1531,97 @@ void ppu::write(unsigned short address, unsigned char value)
 
 void ppu::write(unsigned char value)
 {
+  // Scanlines waiting to be drawn need the pattern and name tables they were logged with
+  if ((vram_address & 0x3FFF) < ADDR_PALETTE_BG)
+  {
+    drawPendingLines();
+  }
+
   if (vram_address < 0x2000)
   {
+    // Only CHR RAM is copied for the render worker
+    if (renderWorker && !hasChrRam)
+    {
+      renderWorker->wait();
+    }
+
     _mapper->writeChrRom(vram_address, value);
+    chrRamDirty = true;
     return;
   }
 
   unsigned short address = normalizeAddress(vram_address);
   video_memory[address] = value;
+
+  if (address < ADDR_PALETTE_BG)
+  {
+    nameTablesDirty = true;
+  }
+
+  // Attribute table write?
+  if (address >= 0x2000 && address <= 0x2FFF && (address & 0x03FF) >= NAME_TABLE_SIZE)
+  {
+    updateAttributeShadow(address, value);
+  }
+  // Palette write?
+  else if (address >= ADDR_PALETTE_BG)
+  {
+    paletteDirty = true;
+  }
+}
+
+// Resolve the colors of a logged scanline, unless its palette and
+// grayscale/emphasis bits are the ones the cache already holds
+void ppu::resolvePalette(const frame_log &log, const scanline_state &line)
+{
+  if (line.palette != paletteCacheSnapshot || (line.mask & PPU_MASK_COLOR_BITS) != paletteCacheMask)
+  {
+    paletteCacheSnapshot = line.palette;
+    paletteCacheMask = line.mask & PPU_MASK_COLOR_BITS;
+    rebuildPaletteCache(log.palettes[line.palette]);
+  }
+}
+
+// Palette RAM is only stored at the normalized address, $3F10/$3F14/$3F18/$3F1C
+// land on $3F00/$3F04/$3F08/$3F0C. The cache keeps both aliases resolved.
+void ppu::rebuildPaletteCache(const unsigned char *palette)
+{
+  for (int index = 0; index < PALETTE_RAM_SIZE; index++)
+  {
+    unsigned char value = palette[(index & 0x03) ? index : index & 0x0F];
+
+    // Grayscale drops the hue bits of the color index
+    if (paletteCacheMask & PPU_MASK_GRAYSCALE)
+    {
+      value &= 0x30;
+    }
+
+    paletteCache[index] = ((paletteCacheMask >> 5) << 6) | (value & 0x3F);
+  }
+}
+
+// Extract the palette bits of the 4x4 tiles covered by an attribute byte
+void ppu::updateAttributeShadow(unsigned short address, unsigned char value)
+{
+  unsigned char nameTable = (address >> 10) & 0x03;
+  unsigned char attributeIndex = (address & 0x03FF) - NAME_TABLE_SIZE;
+  int firstTileX = (attributeIndex & 0x07) * ATTRIBUTE_TILES;
+  int firstTileY = (attributeIndex >> 3) * ATTRIBUTE_TILES;
+
+  for (int tileY = firstTileY; tileY < firstTileY + ATTRIBUTE_TILES; tileY++)
+  {
+    for (int tileX = firstTileX; tileX < firstTileX + ATTRIBUTE_TILES; tileX++)
+    {
+      unsigned char groupShift = ((tileY & 0x02) << 1) | (tileX & 0x02);
+      attributeShadow[nameTable][tileY][tileX] = ((value >> groupShift) & 0x03) << 2;
+    }
+  }
 }
 
 unsigned short ppu::normalizeAddress(unsigned short address)
 {
   address &= 0x3FFF;
-  address = mirrorNameTables(address);
+  address = mirrorNameTables(address, _mapper->getMirroring());
 
   // Nametables/attributetables (0x2000 to 0x2EFF) are mirrored from 0x3000 to ox3EFF
   if (address >= 0x2000 && address <= 0x3EFF)
@@ -680,10 +1647,10 @@ unsigned short ppu::normalizeAddress(unsigned short address)
   return address;
 }
 
-unsigned short ppu::mirrorNameTables(unsigned short address)
+unsigned short ppu::mirrorNameTables(unsigned short address, enum Mirroring mirroring)
 {
   // NT0=0x2000, NT1=0x2400, NT2=0x2800, NT3=0x2C00
-  switch (_mapper->getMirroring())
+  switch (mirroring)
   {
     // Remap 0x2000/0x2400 to NT0 and 0x2800/0x2C00 to NT1
     case Mirroring::Horizontal:
@@ -746,21 +1713,87 @@ unsigned short ppu::mirrorNameTables(unsigned short address)
 
 unsigned char ppu::readRegisterStatus()
 {
+  catchUp();
+
+  // Has the predicted sprite 0 hit been reached?
+  unsigned int position = scanline * PPU_PER_SCANLINE + ppuCycles;
+
+  if (position >= spriteZeroHitDot)
+  {
+    ppu_status |= PPU_STATUS_SPRITE_ZERO_HIT;
+  }
+
   unsigned char value = ppu_status;
   vram_access_flipflop = false;
   ppu_status &= ~PPU_STATUS_VBLANK_STARTED;
   return value;
 }
 
+// CPU cycles that can pass before the VBlank or sprite 0 hit flag of $2002
+// could read differently. Used to fast forward loops polling the register.
+unsigned int ppu::cyclesUntilStatusChange()
+{
+  catchUp();
+
+  unsigned int position = scanline * PPU_PER_SCANLINE + ppuCycles;
+  unsigned int change;
+
+  // VBlank is set and cleared at the start of a scanline, the hit flag at the end of the frame
+  if (scanline < SCANLINE_VBLANK_START)
+  {
+    change = SCANLINE_VBLANK_START * PPU_PER_SCANLINE;
+  }
+  else if (scanline <= SCANLINE_VBLANK_END)
+  {
+    change = (SCANLINE_VBLANK_END + 1) * PPU_PER_SCANLINE;
+  }
+  else
+  {
+    change = (SCANLINE_FRAME_END + 1) * PPU_PER_SCANLINE;
+  }
+
+  if (spriteZeroHitDot != SPRITE_ZERO_NO_HIT)
+  {
+    if (spriteZeroHitDot > position && spriteZeroHitDot < change)
+    {
+      change = spriteZeroHitDot;
+    }
+  }
+  // Sprite 0 may still hit on a scanline that hasn't been rendered yet
+  else if ((ppu_mask & (PPU_MASK_SHOW_SPRITES | PPU_MASK_SHOW_BG)) == (PPU_MASK_SHOW_SPRITES | PPU_MASK_SHOW_BG))
+  {
+    unsigned short spriteTop = sprite_memory[SPRITE_ZERO] + 1;
+    unsigned short spriteBottom = spriteTop + ((ppu_control & PPU_CONTROL_SPRITE_SIZE) ? 15 : 7);
+    unsigned short line = (scanline + 1 > spriteTop) ? scanline + 1 : spriteTop;
+
+    if (line <= spriteBottom && line <= SCANLINE_RENDER_END && line * PPU_PER_SCANLINE < change)
+    {
+      change = line * PPU_PER_SCANLINE;
+    }
+  }
+
+  if (change <= position)
+  {
+    return 0;
+  }
+
+  return (change - position - 1) / PPU_PER_CPU_CYCLE;
+}
+
 unsigned char ppu::readRegisterOAMData()
 {
+  catchUp();
+
   unsigned char value = sprite_memory[sprite_address];
   return value;
 }
 
 unsigned char ppu::readRegisterVRAMData()
 {
+  catchUp();
+
   unsigned char value = 0;
+  STATS_INC(vramReads);
 
   // Return buffered latch value if not palette address
   if (vram_address >= 0x0000 && vram_address <= 0x3EFF)
@@ -783,30 +1816,65 @@ unsigned char ppu::readRegisterVRAMData()
 
 void ppu::writeRegisterControl(unsigned char value)
 {
+  catchUp();
+
   //BOOST_ASSERT_MSG(!(ppu_control & PPU_CONTROL_SPRITE_SIZE), "8x16 sprites not supported yet\n");
 
+  int rises = a12RisesPerLine();
+
   vram_latch = (vram_latch & ~(3 << 10)) | ((value & 3) << 10);
   ppu_control = value;
+
+  if (!a12Observers.empty() && a12RisesPerLine() != rises)
+  {
+    notifyA12TimingChanged();
+    scheduleCatchUp();
+  }
+
+  splitScanline();
+
+  // Enabling NMI during VBlank triggers it right away
+  checkNmi();
 }
 
 void ppu::writeRegisterMask(unsigned char value)
 {
+  catchUp();
+
+  bool rendering = isRenderingEnabled();
+
   ppu_mask = value;
+
+  if (!a12Observers.empty() && isRenderingEnabled() != rendering)
+  {
+    notifyA12TimingChanged();
+    scheduleCatchUp();
+  }
+
+  splitScanline();
 }
 
 void ppu::writeRegisterOAMAddr(unsigned char value)
 {
+  catchUp();
+
   sprite_address = value;
 }
 
 void ppu::writeRegisterOAMData(unsigned char value)
 {
+  catchUp();
+
   sprite_memory[sprite_address] = value;
   sprite_address++;
+  oamDirty = true;
+  STATS_INC(oamWrites);
 }
 
 void ppu::writeRegisterScroll(unsigned char value)
 {
+  catchUp();
+
   if (!vram_access_flipflop)
   {
     ppu_scroll_origin = value << 8;
@@ -822,10 +1890,13 @@ void ppu::writeRegisterScroll(unsigned char value)
   }
 
   vram_access_flipflop = !vram_access_flipflop;
+  splitScanline();
 }
 
 void ppu::writeRegisterVRAMAddr(unsigned char value)
 {
+  catchUp();
+
   if (!vram_access_flipflop)
   {
     vram_address = value << 8; // TODO: remove?
@@ -836,6 +1907,29 @@ void ppu::writeRegisterVRAMAddr(unsigned char value)
     //vram_address |= value;  // TODO: remove?
     vram_latch = (vram_latch & ~0xFF) | value;
     vram_address = vram_latch;
+
+    // The new address is used from the next tile fetch, two tiles ahead of
+    // the one on screen. Rewind it to where the line would have started.
+    if (isLineSplittable())
+    {
+      unsigned short tileNum = ((ppuCycles ? ppuCycles - 1 : 0) + scroll_x) / TILE_WIDTH + SPLIT_FETCH_TILES;
+      unsigned short lineAddress = vram_address;
+
+      for (int i = 0; i < tileNum; i++)
+      {
+        if ((lineAddress & 0x001F) == 0)
+        {
+          lineAddress |= 0x001F;
+          lineAddress ^= 0x0400;
+        }
+        else
+        {
+          lineAddress--;
+        }
+      }
+
+      logSplit(tileNum * TILE_WIDTH - scroll_x, lineAddress);
+    }
   }
 
   vram_access_flipflop = !vram_access_flipflop;
@@ -843,12 +1937,17 @@ void ppu::writeRegisterVRAMAddr(unsigned char value)
 
 void ppu::writeRegisterVRAMData(unsigned char value)
 {
+  catchUp();
+
   write(value);
   vram_address += (ppu_control & PPU_CONTROL_VRAM_ADDR_INCR ? 32 : 1);
+  STATS_INC(vramWrites);
 }
 
 void ppu::writeDMA(unsigned char value)
 {
+  catchUp();
+
   unsigned short baseAddress = value * SPRITE_RAM_SIZE;
   int i = 0;
 
@@ -858,5 +1957,7 @@ void ppu::writeDMA(unsigned char value)
     i++;
   }
 
-  ppuCycles += DMA_CYCLES * PPU_PER_CPU_CYCLE;
+  oamDirty = true;
+  STATS_INC(dmaTransfers);
+  STATS_ADD(oamWrites, SPRITE_RAM_SIZE);
 }
@@ -2,12 +2,18 @@
 #define _PPU_H_
 
 #include <vector>
+#include <set>
 #include <boost/shared_ptr.hpp>
 #include "ines.h"
+#include "cartridge.h"
+#include "ppu_bus_observer.h"
+#include "machine_state.h"
 
 class cpu;
-class Cartridge;
 class Renderer;
+class Scheduler;
+class RenderWorker;
+class CaptureWriter;
 
 #define SCREEN_WIDTH      256
 #define SCREEN_HEIGHT      240
@@ -17,24 +23,39 @@ class Renderer;
 #define VRAM_SIZE      16384
 #define SPRITE_RAM_SIZE    256
 #define NAME_TABLE_SIZE    960
+#define NAME_TABLE_BYTES    1024  // Name table and its attribute table
 #define NAME_TABLE_WIDTH  32
 #define NAME_TABLE_HEIGHT  30
+#define NAME_TABLE_COUNT  4
+#define ATTRIBUTE_TILES    4  // Tiles covered by an attribute byte in each direction
 #define GROUP_WIDTH      8
 #define GROUP_HEIGHT    8
 #define TILE_WIDTH      8
 #define TILE_HEIGHT      8
+#define PATTERN_BYTE_BROADCAST  0x0101010101010101ULL
+#define OPAQUE_MASK_WORDS  (SCREEN_WIDTH / 64)  // 256-bit opaque pixel mask of a scanline
+#define OPAQUE_NO_OVERLAP  -1
 
 #define ADDR_PATTERN_TABLE0    0x0000
 #define ADDR_PATTERN_TABLE1    0x1000
 
 #define ADDR_PALETTE_BG      0x3F00
 #define ADDR_PALETTE_SPRITE    0x3F10
+#define PALETTE_RAM_SIZE    32
+#define PALETTE_COLORS      64
+#define PALETTE_EMPHASIS_LEVELS  8
+#define PALETTE_TABLE_SIZE    (PALETTE_COLORS * PALETTE_EMPHASIS_LEVELS)
+#define PALETTE_SPRITE_OFFSET  0x10
+#define PALETTE_SNAPSHOT_NONE  0xFFFF
 #define SPRITE_FIRST_ENTRY    252
 #define SPRITE_ZERO       0
 #define SPRITE_ENTRY_SIZE    4
 #define SPRITE_OVERFLOW_COUNT  8
+#define FRAME_LOG_SPLITS    1024  // Mid-scanline state changes kept per frame
+#define SPLIT_FETCH_TILES    2  // Tiles fetched ahead of the one on screen
 
 #define DMA_CYCLES       512
+#define SPRITE_ZERO_NO_HIT  0xFFFFFFFF
 
 #define PPU_PER_CPU_CYCLE    3
 #define PPU_PER_SCANLINE    341
@@ -44,8 +65,16 @@ class Renderer;
 #define SCANLINE_VBLANK_START  240
 #define SCANLINE_VBLANK_END    259
 #define SCANLINE_FRAME_END    261
+#define SCANLINE_PRERENDER    261
 #define SCANLINE_INIT      241
 
+#define FETCH_GROUP_DOTS    8
+#define FETCH_GROUPS_BG      32
+#define FETCH_GROUPS_PREFETCH  2
+#define SPRITE_SLOTS      8
+#define A12_FILTER_DOTS      10  // A12 must stay low ~3 CPU cycles before a rise counts (MMC3)
+#define A12_UNPREDICTABLE    -1  // 8x16 sprites, rises depend on OAM contents
+
 #define PPU_CONTROL_NAMETABLE_ADDR1   0x01
 #define PPU_CONTROL_NAMETABLE_ADDR2   0x02
 #define PPU_CONTROL_VRAM_ADDR_INCR   0x04
@@ -54,6 +83,7 @@ class Renderer;
 #define PPU_CONTROL_SPRITE_SIZE     0x20
 #define PPU_CONTROL_PPU_SELECT     0x40
 #define PPU_CONTROL_NMI         0x80
+#define PPU_CONTROL_RENDER_BITS  (PPU_CONTROL_SPRITE_PATTERN_ADDR | PPU_CONTROL_BG_PATTERN_ADDR | PPU_CONTROL_SPRITE_SIZE)
 
 #define PPU_MASK_GRAYSCALE    0x01
 #define PPU_MASK_BG_LEFT    0x02
@@ -63,6 +93,7 @@ class Renderer;
 #define PPU_MASK_INTENSE_RED  0x20
 #define PPU_MASK_INTENSE_GREEN  0x40
 #define PPU_MASK_INTENSE_BLUE  0x80
+#define PPU_MASK_COLOR_BITS    (PPU_MASK_GRAYSCALE | PPU_MASK_INTENSE_RED | PPU_MASK_INTENSE_GREEN | PPU_MASK_INTENSE_BLUE)
 
 #define PPU_STATUS_LAST_PPU_WRITES1  0x01
 #define PPU_STATUS_LAST_PPU_WRITES2  0x02
@@ -85,6 +116,55 @@ typedef struct
   unsigned char b;
 } palette_entry;
 
+// PPU state a visible scanline starts with, enough to draw it later
+typedef struct
+{
+  unsigned short vramAddress;
+  unsigned char scrollX;
+  unsigned char control;
+  unsigned char mask;
+  enum Mirroring mirroring;
+  unsigned char *chrPages[CHR_BANKS];
+  unsigned short palette;  // Index into frame_log::palettes
+  unsigned short oam;  // Index into frame_log::oams
+  unsigned short firstSplit;  // Index into frame_log::splits
+  unsigned short splitCount;
+} scanline_state;
+
+// State a scanline goes on with from pixel x, after a register or mapper
+// write in the middle of it. The state is the one the whole line would be
+// drawn with, vramAddress is rewound to the start of the line.
+typedef struct
+{
+  unsigned short x;
+  scanline_state state;
+} scanline_split;
+
+// Scanlines of a frame. Palette RAM and OAM are only copied when they have
+// changed, name tables and CHR RAM when the logged lines are about to be drawn.
+typedef struct
+{
+  scanline_state lines[SCREEN_HEIGHT];
+  unsigned char palettes[SCREEN_HEIGHT][PALETTE_RAM_SIZE];
+  unsigned char oams[SCREEN_HEIGHT][SPRITE_RAM_SIZE];
+  scanline_split splits[FRAME_LOG_SPLITS];
+  unsigned char nameTables[NAME_TABLE_COUNT * NAME_TABLE_BYTES];
+  unsigned char attributes[NAME_TABLE_COUNT][NAME_TABLE_WIDTH][NAME_TABLE_WIDTH];
+  unsigned char chrRam[CHR_ROM_SIZE];
+  unsigned short lineCount;
+  unsigned short drawnLines;
+  unsigned short paletteCount;
+  unsigned short oamCount;
+  unsigned short splitCount;
+} frame_log;
+
+typedef struct
+{
+  unsigned short low;
+  unsigned short high;
+  PpuBusObserver *observer;
+} fetch_watch;
+
 class ppu
 {
 public:
@@ -93,15 +173,19 @@ public:
   void init(
     boost::shared_ptr<Cartridge> mapper,
     boost::shared_ptr<Renderer> renderer,
-    boost::shared_ptr<cpu> cpu);
+    boost::shared_ptr<cpu> cpu,
+    boost::shared_ptr<Scheduler> scheduler);
   bool isInitialized() { return _isInitialized; }
   void start();
   void stop();
   void reset();
-  void execute(unsigned short cycles);
+  void catchUp();
+  void splitScanline();
+  void log();
 
   // Read operations
   unsigned char readRegisterStatus();
+  unsigned int cyclesUntilStatusChange();
   unsigned char readRegisterOAMData();
   unsigned char readRegisterVRAMData();
 
@@ -115,11 +199,38 @@ public:
   void writeRegisterVRAMData(unsigned char value);
   void writeDMA(unsigned char value);
 
+  // Mapper subscriptions to the PPU address bus
+  void addA12Observer(PpuBusObserver *observer);
+  void addFetchObserver(PpuBusObserver *observer, unsigned short low, unsigned short high);
+  unsigned long long getA12Rises() { catchUp(); return a12Rises; };
+
+  unsigned long long getFrameCount() { return frameCount; };
+
+  // Only complete after waitForFrame() while frames are drawn on a worker thread
+  const unsigned short *getFrameBuffer() { return frameBuffer; };
+  void waitForFrame();
+  const palette_entry *getColorTable() { return colorTable; };
+
+  // Draws the frame getFrameCount() reaches `frame` with, even when headless
+  void requestFrame(unsigned long long frame) { requestedFrames.insert(frame); };
+
+  void saveState(machine_state &state);
+  unsigned long long cyclesUntilA12Rise(unsigned long long rise);
+
 private:
   boost::shared_ptr<Cartridge> _mapper;
   boost::shared_ptr<Renderer> _renderer;
   boost::shared_ptr<cpu> _cpu;
+  boost::shared_ptr<Scheduler> _scheduler;
+  boost::shared_ptr<RenderWorker> renderWorker;
+  boost::shared_ptr<CaptureWriter> captureWriter;
   bool _isInitialized;
+  unsigned char * const *chrPages;
+  std::vector<PpuBusObserver*> a12Observers;
+  std::vector<fetch_watch> fetchWatches;
+  bool a12High;
+  unsigned long long a12LowSince;
+  unsigned long long a12Rises;
 
   unsigned char *video_memory;
   unsigned char *sprite_memory;
@@ -129,6 +240,10 @@ private:
   unsigned char scroll_y;
   unsigned char sprite_address;
   std::vector<palette_entry> palette_table;
+  palette_entry colorTable[PALETTE_TABLE_SIZE];  // Colors with every emphasis combination, see palette.h
+  unsigned short paletteCache[PALETTE_RAM_SIZE];  // Color table indices of $3F00-$3F1F
+  unsigned char paletteCacheMask;  // Grayscale and emphasis bits the cache was resolved with
+  unsigned short paletteCacheSnapshot;  // Frame log palette the cache was resolved from
   std::vector<unsigned char> defaultPalette;
 
   bool transferLatch;
@@ -150,28 +265,88 @@ private:
   bool spriteSize;
   bool bgPattern;
   bool spritePattern;
-  unsigned char spritesOnScanline;
+  unsigned char attributeShadow[NAME_TABLE_COUNT][NAME_TABLE_WIDTH][NAME_TABLE_WIDTH];  // Palette bits per tile, rows 30-31 are fetched when scrolled into the attribute area
+  unsigned long long patternSpread[256];  // Pattern plane byte => 8 pixel bytes
+  unsigned char patternReverse[256];  // Pattern plane byte => leftmost pixel in bit 0
+  unsigned short frameBuffer[SCREEN_WIDTH * SCREEN_HEIGHT];  // Color table indices, emphasis in bits 6-8
+  unsigned int spriteZeroHitDot;
 
   timespec lastScreenUpdate, now, diff;
   unsigned short ppuCycles;
   unsigned short scanline;
-  unsigned short previousScanline;
+  unsigned long long syncedCycles;  // Scheduler cycle the PPU has caught up to
+  unsigned long long frameCount;
+  std::set<unsigned long long> requestedFrames;
+
+  frame_log frameLogs[2];  // One is drawn by the render worker while the other is logged
+  frame_log *frameLog;
+  bool isFrameRequested;
+  bool isFramePending;  // Drawn by the render worker, not on screen yet
+  bool paletteDirty;
+  bool oamDirty;
+  bool nameTablesDirty;
+  bool chrRamDirty;
+  bool hasChrRam;
 
   unsigned char read(unsigned short address);
   void write(unsigned short address, unsigned char value);
   unsigned char read();
+  unsigned char readChr(unsigned short address);
+  unsigned char peekChr(unsigned short address) { return chrPages[address >> 10][address & 0x03FF]; };  // Not seen by mappers
+  unsigned char readPattern(const scanline_state &line, unsigned short address);
+  void notifyFetch(unsigned short address);
   void write(unsigned char value);
   unsigned short normalizeAddress(unsigned short address);
-  unsigned short mirrorNameTables(unsigned short address);
+  unsigned short mirrorNameTables(unsigned short address, enum Mirroring mirroring);
+  void updateAttributeShadow(unsigned short address, unsigned char value);
+  void resolvePalette(const frame_log &log, const scanline_state &line);
+  void rebuildPaletteCache(const unsigned char *palette);
+  bool isRenderingEnabled();
+  void checkNmi();
+  void scheduleCatchUp();
+  void nextScanline();
+  void startScanline();
+  void startFrameLog();
+  bool isFrameWanted();
+  void captureScanline(scanline_state &line);
+  void logScanline();
+  bool isLineSplittable();
+  void logSplit(unsigned short x, unsigned short vramAddress);
+  const scanline_state &currentLineState();
+  void relocateChrRam(scanline_state &line, unsigned char *chrMemory);
+  void snapshotMemory();
+  void finishFrameLog();
+  void evaluateSpriteOverflow();
+  void incrementScrollY();
+  int a12RisesPerLine();
+  void notifyA12TimingChanged();
+  void clockA12(unsigned short line);
+  void settleA12(unsigned short line);
+  void setA12(bool high, unsigned long long dot);
 
-  void renderToBuffer();
-  void renderBackground();
-  void renderSprites(unsigned char backgroundPriority = 0);
-  void renderTile8x8(unsigned char backgroundPriority);
-  void renderTile8x16(unsigned char backgroundPriority);
+  void drawPendingLines();
+  void drawLoggedLines(frame_log &log);
+  void drawScanline(const frame_log &log, unsigned short y);
+  void composeScanline(const frame_log &log, const scanline_state &line, unsigned short y, unsigned short *output);
+  void renderBackground(
+    const scanline_state &line,
+    const unsigned char *nameTables,
+    const unsigned char (*attributes)[NAME_TABLE_WIDTH][NAME_TABLE_WIDTH],
+    unsigned char *pixels,
+    unsigned long long *opaque);
+  void fillOpaqueMask(const unsigned char *tilePixels, int tiles, unsigned char fineX, unsigned long long *opaque);
+  static int firstOpaqueOverlap(const unsigned long long *a, const unsigned long long *b);
+  static bool isOpaque(const unsigned long long *opaque, int x) { return (opaque[x >> 6] >> (x & 63)) & 1; };
+  void renderSprites(const frame_log &log, const scanline_state &line, unsigned short y, unsigned char *spritePixels);
+  void renderTile8x8(const frame_log &log, const scanline_state &line, unsigned short y, unsigned char *spritePixels);
+  void renderTile8x16(const frame_log &log, const scanline_state &line, unsigned short y, unsigned char *spritePixels);
+  void predictSpriteZeroHit();
+  void peekBackgroundMask(unsigned long long *opaque);
   void updateScreen();
+  void presentFrame();
+  void presentPendingFrame();
 
-  void log();
+  friend class Benchmark;
 };
 
 #endif
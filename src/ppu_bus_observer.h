@@ -0,0 +1,23 @@
+#ifndef _PPU_BUS_OBSERVER_H_
+#define _PPU_BUS_OBSERVER_H_
+
+// Interface for mappers that need to follow the PPU address bus.
+// Nothing is delivered unless the mapper subscribes through
+// ppu::addA12Observer() or ppu::addFetchObserver().
+class PpuBusObserver
+{
+public:
+  virtual ~PpuBusObserver() {};
+
+  // PPU A12 went high after being low long enough to pass the MMC3 filter
+  virtual void a12Rise() {};
+
+  // Rendering was toggled or the pattern table setup changed, so rises counted
+  // by ppu::getA12Rises() may arrive at a different pace from now on
+  virtual void a12TimingChanged() {};
+
+  // A pattern fetch hit one of the address ranges the observer subscribed to
+  virtual void watchedFetch(unsigned short) {};
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "render_worker.h"
+
+RenderWorker::RenderWorker(std::function<void(frame_log*)> drawFrame)
+:
+  _drawFrame(drawFrame),
+  isRunning(false),
+  pending(nullptr)
+{}
+
+RenderWorker::~RenderWorker()
+{
+  stop();
+}
+
+void RenderWorker::start()
+{
+  isRunning = true;
+  t = std::thread(&RenderWorker::run, this);
+}
+
+// Draws the pending frame before returning
+void RenderWorker::stop()
+{
+  if (!t.joinable())
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m);
+    isRunning = false;
+  }
+
+  wakeUp.notify_one();
+  t.join();
+}
+
+void RenderWorker::submit(frame_log *log)
+{
+  {
+    std::lock_guard<std::mutex> lock(m);
+    pending = log;
+  }
+
+  wakeUp.notify_one();
+}
+
+// Block until the submitted frame has been drawn
+void RenderWorker::wait()
+{
+  std::unique_lock<std::mutex> lock(m);
+  idle.wait(lock, [this]() { return pending == nullptr; });
+}
+
+void RenderWorker::run()
+{
+  while (true)
+  {
+    frame_log *log;
+
+    {
+      std::unique_lock<std::mutex> lock(m);
+      wakeUp.wait(lock, [this]() { return pending != nullptr || !isRunning; });
+
+      if (pending == nullptr)
+      {
+        break;
+      }
+
+      log = pending;
+    }
+
+    _drawFrame(log);
+
+    {
+      std::lock_guard<std::mutex> lock(m);
+      pending = nullptr;
+    }
+
+    idle.notify_all();
+  }
+}
@@ -0,0 +1,35 @@
+#ifndef _RENDER_WORKER_H_
+#define _RENDER_WORKER_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "ppu.h"
+
+// Draws a logged frame on its own thread while the emulation thread runs the
+// next one. There is only ever one frame in flight, wait() for it before
+// submitting the next.
+class RenderWorker
+{
+public:
+  RenderWorker(std::function<void(frame_log*)> drawFrame);
+  ~RenderWorker();
+  void start();
+  void stop();
+  void submit(frame_log *log);
+  void wait();
+
+private:
+  std::function<void(frame_log*)> _drawFrame;
+  std::thread t;
+  std::mutex m;
+  std::condition_variable wakeUp;
+  std::condition_variable idle;
+  bool isRunning;
+  frame_log *pending;  // Submitted and not drawn yet
+
+  void run();
+};
+
+#endif
@@ -5,36 +5,25 @@
 
 using namespace std;
 
-enum PixelType { BackgroundTile, ForegroundSprite, BackgroundSprite };
-
 class Renderer
 {
 public:
-  Renderer() {};
+  Renderer() : colors(NULL) {};
   virtual void init() = 0;
   virtual void cleanup() = 0;
-  virtual void update() = 0;
-  virtual void clear(const palette_entry &entry) = 0;
-  virtual void setTransparentPixel(int x, int y) = 0;
-  virtual bool isTransparentPixel(int x, int y) = 0;
-
-  void setPixel(const enum PixelType &type, int x, int y, const palette_entry &color)
-  {
-    if (x < 8 || x > SCREEN_WIDTH - 8)
-    {
-      return;
-    }
-
-    if (type != PixelType::BackgroundTile && (y < 16 || y > SCREEN_HEIGHT - 11))
-    {
-      return;
-    }
-
-    putPixel(type, x, y, color, 255);
-  }
+
+  // Present a finished frame, SCREEN_WIDTH x SCREEN_HEIGHT indices into the color table
+  virtual void update(const unsigned short *frame) = 0;
+  virtual bool isHeadless() { return false; }
+
+  // Frames are presented at 60 Hz, not as fast as they are emulated
+  virtual bool isPaced() { return !isHeadless(); }
+
+  // Colors for every frame buffer index, set before init()
+  void setColors(const palette_entry *table) { colors = table; }
 
 protected:
-  virtual void putPixel(const enum PixelType &type, int x, int y, const palette_entry &color, unsigned char alpha) = 0;
+  const palette_entry *colors;
 };
 
 #endif
@@ -1,6 +1,8 @@
 #include "renderer_factory.h"
 #include "yane_exception.h"
 #include "renderers/sdlrenderer.h"
+#include "renderers/shmrenderer.h"
+#include "renderers/nullrenderer.h"
 #include <boost/make_shared.hpp>
 
 boost::shared_ptr<Renderer> RendererFactory::create(const std::string &name)
@@ -13,6 +15,14 @@ boost::shared_ptr<Renderer> RendererFactory::create(const std::string &name)
       return boost::make_shared<SDLRenderer>();
       break;
 
+    case RendererType::Shm:
+      return boost::make_shared<ShmRenderer>();
+      break;
+
+    case RendererType::Null:
+      return boost::make_shared<NullRenderer>();
+      break;
+
     default:
       throw RendererNotSupportedException(name);
       break;
@@ -34,5 +44,7 @@ enum RendererType RendererFactory::lookupType(const std::string &name)
 const std::map<std::string, RendererType> RendererFactory::lookupTable =
 {
   {"sdl", RendererType::SDL},
+  {"shm", RendererType::Shm},
+  {"null", RendererType::Null},
   {"",    RendererType::Unknown},
 };
@@ -5,7 +5,7 @@
 #include <map>
 #include <boost/shared_ptr.hpp>
 
-enum RendererType { SDL, Unknown };
+enum RendererType { SDL, Shm, Null, Unknown };
 
 class RendererFactory
 {
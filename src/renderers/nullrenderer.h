@@ -0,0 +1,19 @@
+#ifndef _NULLRENDERER_H_
+#define _NULLRENDERER_H_
+
+#include "renderer.h"
+
+using namespace std;
+
+// Headless renderer, the PPU doesn't draw any frames for it
+class NullRenderer : public Renderer
+{
+public:
+  NullRenderer() {};
+  void init() {};
+  void cleanup() {};
+  void update(const unsigned short *frame) {};
+  bool isHeadless() { return true; };
+};
+
+#endif
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <boost/make_shared.hpp>
+
 #include "renderers/sdlrenderer.h"
 #include "config.h"
 #include "yane_exception.h"
@@ -44,159 +47,163 @@ void SDLRenderer::init()
     throw SDLVideoException(width, height, bpp);
   }
 
-  bg = SDL_DisplayFormatAlpha(screen);
-  sprFg = SDL_DisplayFormatAlpha(screen);
-  sprBg = SDL_DisplayFormatAlpha(screen);
-
-  // Set window title
-  std::string title = "Yane " + Config::instance().getVersion();
-  SDL_WM_SetCaption(title.c_str(), 0);
-}
-
-void SDLRenderer::cleanup()
-{
-  // Cleanup SDL
-  SDL_FreeSurface(screen);
-  SDL_FreeSurface(bg);
-  SDL_FreeSurface(sprFg);
-  SDL_FreeSurface(sprBg);
-
-  screen = NULL;
-  bg = NULL;
-  sprFg = NULL;
-  sprBg = NULL;
-}
-
-void SDLRenderer::update()
-{
-  // Update screen with background and sprite surfaces
-  SDL_BlitSurface(sprBg, NULL, screen, NULL);
-  SDL_BlitSurface(bg, NULL, screen, NULL);
-  SDL_BlitSurface(sprFg, NULL, screen, NULL);
-  SDL_Flip(screen);
-}
+  // Convert straight into the screen if its format is supported, else into
+  // a frame surface that SDL blits
+  SDL_PixelFormat *format = screen->format;
+  enum PixelFormat pixelFormat = PixelFormat::XRGB8888;
+  bool isDirect = true;
 
-void SDLRenderer::clear(const palette_entry &entry)
-{
-  // Clear screen
-  int color = SDL_MapRGBA(screen->format, 0, 0, 0, 0);
-  SDL_Rect clearRect = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
-  SDL_FillRect(screen, &clearRect, color);
-  SDL_FillRect(sprBg, &clearRect, color);
-  SDL_FillRect(sprFg, &clearRect, color);
-  SDL_FillRect(bg, &clearRect, color);
-
-  // Fill screen with background color
-  SDL_FillRect(screen, &clearRect, SDL_MapRGB(screen->format, entry.r, entry.g, entry.b));
-}
-
-void SDLRenderer::putPixel(const enum PixelType &type, int x, int y, const palette_entry &color, unsigned char alpha)
-{
-  if (alpha == 0)
-    return;
-
-  SDL_Surface *surface = getSurface(type);
-  int bpp = surface->format->BytesPerPixel;
-  char *p = (char*)surface->pixels + y * surface->pitch + x * bpp;
-  int pixel = SDL_MapRGBA(surface->format, color.r, color.g, color.b, alpha);
-
-  switch (bpp)
+  if (format->BytesPerPixel == 2 && format->Rmask == 0xF800 && format->Gmask == 0x07E0 && format->Bmask == 0x001F)
   {
-  case 1:
-    *p = pixel;
-    break;
+    pixelFormat = PixelFormat::RGB565;
+  }
+  else if (format->BytesPerPixel != 4 || format->Rmask != 0xFF0000 || format->Gmask != 0x00FF00 || format->Bmask != 0x0000FF)
+  {
+    isDirect = false;
+  }
 
-  case 2:
-    *(short*)p = (short)pixel;
-    break;
+  // Cropped edges are left black, the picture stays where it was
+  Config &config = Config::instance();
+  overscan_crop crop = { config.overscanTop, config.overscanBottom, config.overscanLeft, config.overscanRight };
+  unsigned int threads = config.scaleThreads ? config.scaleThreads : std::min(std::thread::hardware_concurrency(), 4u);
+  converter = boost::make_shared<FrameConverter>(colors, pixelFormat, crop);
+  frameRect.x = crop.left;
+  frameRect.y = crop.top;
+  frameRect.w = converter->getWidth();
+  frameRect.h = converter->getHeight();
+
+  if (config.ntscFilter)
+  {
+    workers = boost::make_shared<BandWorkers>(std::max(threads, 1u));
+    ntscFilter = boost::make_shared<NtscFilter>(pixelFormat, crop, config.paletteHue, config.paletteSaturation, workers);
 
-  case 3:
-    if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
+    if (ntscFilter->getWidth() > screen->w || ntscFilter->getHeight() > screen->h)
     {
-      p[0] = (pixel >> 16) & 0xff;
-      p[1] = (pixel >> 8) & 0xff;
-      p[2] = pixel & 0xff;
+      printf("Screen is too small for the NTSC filter, not using it\n");
+      ntscFilter.reset();
     }
     else
     {
-      p[0] = pixel & 0xff;
-      p[1] = (pixel >> 8) & 0xff;
-      p[2] = (pixel >> 16) & 0xff;
+      frameRect.w = ntscFilter->getWidth();
+      frameRect.h = ntscFilter->getHeight();
+      frameRect.x = (screen->w - frameRect.w) / 2;
+      frameRect.y = (screen->h - frameRect.h) / 2;
     }
-    break;
-
+  }
 
-  case 4:
-    *(int*)p = pixel;
-    break;
+  // Scale by the requested factor, or the largest one that fits the screen
+  enum ScaleFilter filter = config.scaleFilter;
+  int filterScale = Scaler::getFilterScale(filter);
 
-  default:
-    break;
+  if (frameRect.w * filterScale > screen->w || frameRect.h * filterScale > screen->h)
+  {
+    printf("Screen is too small for the scaling filter, not using it\n");
+    filter = ScaleFilter::Nearest;
+    filterScale = 1;
   }
-}
 
-int SDLRenderer::getPixel(SDL_Surface *surface, int x, int y)
-{
-  int bpp = surface->format->BytesPerPixel;
-  char *p = (char*)surface->pixels + y * surface->pitch + x * bpp;
+  int factor = std::min(screen->w / (frameRect.w * filterScale), screen->h / (frameRect.h * filterScale));
 
-  switch (bpp)
+  if (config.scaleFactor > 0 && (int)config.scaleFactor < factor)
   {
-  case 1:
-    return *p;
-    break;
+    factor = config.scaleFactor;
+  }
 
-  case 2:
-    return *(short*)p;
-    break;
+  factor = std::max(factor, 1);
 
-  case 3:
-    if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
-    {
-      return p[0] << 16 | p[1] << 8 | p[2];
-    }
-    else
+  if (filterScale * factor > 1)
+  {
+    int pixelSize = pixelFormat == PixelFormat::RGB565 ? 2 : 4;
+
+    if (!workers)
     {
-      return p[0] | p[1] << 8 | p[2] << 16;
+      workers = boost::make_shared<BandWorkers>(std::max(threads, 1u));
     }
-    break;
 
-  case 4:
-    return *(int*)p;
-    break;
+    scaler = boost::make_shared<Scaler>(pixelSize, frameRect.w, frameRect.h, filter, factor, workers);
+    converted.resize(ntscFilter ? ntscFilter->getFrameSize() : converter->getFrameSize());
 
-  default:
-    return 0;
+    // Centered on the screen
+    frameRect.w = scaler->getWidth();
+    frameRect.h = scaler->getHeight();
+    frameRect.x = std::max(screen->w - frameRect.w, 0) / 2;
+    frameRect.y = std::max(screen->h - frameRect.h, 0) / 2;
   }
-}
 
-void SDLRenderer::setTransparentPixel(int x, int y)
-{
-  palette_entry color = { 1, 2, 3 };
-  putPixel(PixelType::BackgroundTile, x, y, color, 0);
+  frameSurface = NULL;
+
+  if (!isDirect)
+  {
+    frameSurface = SDL_CreateRGBSurface(SDL_SWSURFACE, frameRect.w, frameRect.h, 32, 0xFF0000, 0x00FF00, 0x0000FF, 0);
+  }
+
+  // Set window title
+  std::string title = "Yane " + Config::instance().getVersion();
+  SDL_WM_SetCaption(title.c_str(), 0);
 }
 
-bool SDLRenderer::isTransparentPixel(int x, int y)
+void SDLRenderer::cleanup()
 {
-  unsigned char r, g, b, a;
-  int pixel = getPixel(bg, x, y);
-  SDL_GetRGBA(pixel, bg->format, &r, &g, &b, &a);
-  return (r == 1 && g == 2 && b == 3);
+  // Cleanup SDL
+  SDL_FreeSurface(screen);
+  SDL_FreeSurface(frameSurface);
+
+  screen = NULL;
+  frameSurface = NULL;
+  scaler.reset();
+  ntscFilter.reset();
+  converter.reset();
+  workers.reset();
 }
 
-SDL_Surface *SDLRenderer::getSurface(const enum PixelType &type)
+void SDLRenderer::update(const unsigned short *frame)
 {
-  switch (type)
+  SDL_Surface *target = frameSurface ? frameSurface : screen;
+
+  if (SDL_MUSTLOCK(target) && SDL_LockSurface(target) < 0)
+  {
+    return;
+  }
+
+  unsigned char *pixels = (unsigned char*)target->pixels;
+
+  if (!frameSurface)
   {
-  case PixelType::BackgroundTile:
-    return bg;
+    pixels += frameRect.y * target->pitch + frameRect.x * target->format->BytesPerPixel;
+  }
 
-  case PixelType::ForegroundSprite:
-    return sprFg;
+  if (scaler)
+  {
+    convert(frame, converted.data(), 0);
+    scaler->scale(converted.data(), pixels, target->pitch);
+  }
+  else
+  {
+    convert(frame, pixels, target->pitch);
+  }
 
-  case PixelType::BackgroundSprite:
-    return sprBg;
+  if (SDL_MUSTLOCK(target))
+  {
+    SDL_UnlockSurface(target);
   }
 
-  return bg;
+  if (frameSurface)
+  {
+    SDL_Rect destination = frameRect;
+    SDL_BlitSurface(frameSurface, NULL, screen, &destination);
+  }
+
+  SDL_Flip(screen);
+}
+
+void SDLRenderer::convert(const unsigned short *frame, unsigned char *pixels, int pitch)
+{
+  if (ntscFilter)
+  {
+    ntscFilter->convert(frame, pixels, pitch);
+  }
+  else
+  {
+    converter->convert(frame, pixels, pitch);
+  }
 }
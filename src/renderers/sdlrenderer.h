@@ -4,10 +4,13 @@
 #include <SDL/SDL.h>
 #include <SDL/SDL_gfxPrimitives.h>
 
-#include "renderer.h"
+#include <boost/shared_ptr.hpp>
 
-// Reserve a special RGB value, which is not in the NES palette, to represent a transparent pixel
-#define TRANSPARENT_HACK  0x030201
+#include "renderer.h"
+#include "frame_converter.h"
+#include "scaler.h"
+#include "ntsc_filter.h"
+#include "band_workers.h"
 
 using namespace std;
 
@@ -17,16 +20,19 @@ public:
   SDLRenderer() {};
   void init();
   void cleanup();
-  void update();
-  void clear(const palette_entry &entry);
-  void putPixel(const enum PixelType &type, int x, int y, const palette_entry &color, unsigned char alpha);
-  int getPixel(SDL_Surface *surface, int x, int y);
-  void setTransparentPixel(int x, int y);
-  bool isTransparentPixel(int x, int y);
+  void update(const unsigned short *frame);
 
 private:
-  SDL_Surface *getSurface(const enum PixelType &type);
-  SDL_Surface *screen, *bg, *sprBg, *sprFg;
+  SDL_Surface *screen;
+  SDL_Surface *frameSurface;  // Converted frame when the screen format isn't supported directly
+  SDL_Rect frameRect;
+  boost::shared_ptr<BandWorkers> workers;  // Shared by the NTSC filter and the scaler
+  boost::shared_ptr<FrameConverter> converter;
+  boost::shared_ptr<NtscFilter> ntscFilter;
+  boost::shared_ptr<Scaler> scaler;
+  std::vector<unsigned char> converted;  // Frame waiting to be scaled
+
+  void convert(const unsigned short *frame, unsigned char *pixels, int pitch);
 };
 
 #endif
@@ -0,0 +1,125 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <boost/make_shared.hpp>
+
+#include "renderers/shmrenderer.h"
+#include "config.h"
+#include "yane_exception.h"
+
+void ShmRenderer::init()
+{
+  Config &config = Config::instance();
+  overscan_crop crop = { config.overscanTop, config.overscanBottom, config.overscanLeft, config.overscanRight };
+  converter = boost::make_shared<FrameConverter>(colors, config.shmFormat, crop);
+  name = config.shmName;
+
+  unsigned int slotSize = SHM_FRAME_ALIGN + SHM_ALIGN_UP(converter->getFrameSize());
+  mappedSize = SHM_ALIGN_UP(sizeof(shm_frame_header)) + (size_t)slotSize * config.shmSlots;
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+
+  if (fd < 0)
+  {
+    throw SharedMemoryException(name, strerror(errno));
+  }
+
+  if (ftruncate(fd, mappedSize) < 0)
+  {
+    int error = errno;
+    close(fd);
+    shm_unlink(name.c_str());
+    throw SharedMemoryException(name, strerror(error));
+  }
+
+  void *memory = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (memory == MAP_FAILED)
+  {
+    int error = errno;
+    shm_unlink(name.c_str());
+    throw SharedMemoryException(name, strerror(error));
+  }
+
+  // The file is zero filled, which is a valid initial state for the counters.
+  // The magic goes in last, readers wait for it.
+  header = (shm_frame_header*)memory;
+  header->version = SHM_FRAME_VERSION;
+  header->width = converter->getWidth();
+  header->height = converter->getHeight();
+  header->format = config.shmFormat;
+  header->frameSize = converter->getFrameSize();
+  header->slotCount = config.shmSlots;
+  header->slotSize = slotSize;
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = SHM_FRAME_MAGIC;
+
+  printf("Publishing %dx%d frames to shared memory %s\n", header->width, header->height, name.c_str());
+}
+
+void ShmRenderer::cleanup()
+{
+  if (!header)
+  {
+    return;
+  }
+
+  printf("Shared memory: %llu frames published, %llu dropped\n", header->published.load(), header->dropped.load());
+
+  // Readers keep their mapping, tell them no more frames are coming
+  header->closed.store(1);
+  header->notify.fetch_add(1);
+  wakeReaders();
+
+  munmap(header, mappedSize);
+  shm_unlink(name.c_str());
+  header = NULL;
+  converter.reset();
+}
+
+void ShmRenderer::update(const unsigned short *frame)
+{
+  unsigned long long number = header->published.load(std::memory_order_relaxed);
+  shm_frame_slot *slot = getSlot(number);
+
+  // The frame in this slot is lost if an attached reader hasn't reached it
+  unsigned long long consumed = header->consumed.load(std::memory_order_relaxed);
+
+  if (number >= header->slotCount && consumed > 0 && consumed <= number - header->slotCount)
+  {
+    header->dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  slot->sequence.store(2 * number + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  converter->convert(frame, (unsigned char*)slot + SHM_FRAME_ALIGN);
+
+  slot->sequence.store(2 * number + 2, std::memory_order_release);
+  header->published.store(number + 1, std::memory_order_release);
+  header->notify.fetch_add(1);
+
+  // The futex system call is only needed if a reader is asleep. Readers
+  // count themselves in before they check `notify`, so one can't be missed.
+  if (header->waiters.load() > 0)
+  {
+    wakeReaders();
+  }
+}
+
+shm_frame_slot *ShmRenderer::getSlot(unsigned long long frame)
+{
+  unsigned char *slots = (unsigned char*)header + SHM_ALIGN_UP(sizeof(shm_frame_header));
+  return (shm_frame_slot*)(slots + (frame % header->slotCount) * header->slotSize);
+}
+
+void ShmRenderer::wakeReaders()
+{
+  syscall(SYS_futex, (int*)&header->notify, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
@@ -0,0 +1,75 @@
+#ifndef _SHMRENDERER_H_
+#define _SHMRENDERER_H_
+
+#include <atomic>
+#include <string>
+#include <boost/shared_ptr.hpp>
+
+#include "renderer.h"
+#include "frame_converter.h"
+
+using namespace std;
+
+#define SHM_FRAME_MAGIC    0x454E4159  // "YANE"
+#define SHM_FRAME_VERSION  1
+#define SHM_FRAME_ALIGN    64
+
+#define SHM_ALIGN_UP(size)  (((size) + SHM_FRAME_ALIGN - 1) & ~(SHM_FRAME_ALIGN - 1))
+
+// Shared memory layout: the header, then `slotCount` slots of `slotSize`
+// bytes, starting SHM_ALIGN_UP(sizeof(shm_frame_header)) bytes in. Frame n
+// is written to slot n % slotCount, its pixels start SHM_FRAME_ALIGN bytes
+// into the slot.
+//
+// A reader waits for the magic, then takes frames in order or skips ahead to
+// frame `published - 1`. After taking frame n it stores n + 1 in `consumed`.
+// A frame is dropped when it is overwritten at or after `consumed`, frames a
+// reader skipped over are not. To sleep it increments `waiters`, reads
+// `notify`, checks `published` again and waits on the `notify` futex for the
+// value it read. src/tools/shm_reader.h is a reader.
+typedef struct
+{
+  unsigned int magic;
+  unsigned int version;
+  unsigned int width;
+  unsigned int height;
+  unsigned int format;  // enum PixelFormat
+  unsigned int frameSize;
+  unsigned int slotCount;
+  unsigned int slotSize;
+  std::atomic<unsigned long long> published;  // Frames published so far
+  std::atomic<unsigned long long> consumed;  // Index of the last frame the reader took + 1, it updates this itself
+  std::atomic<unsigned long long> dropped;  // Frames overwritten before the reader reached them
+  std::atomic<unsigned int> notify;  // Futex word, bumped after every frame
+  std::atomic<unsigned int> waiters;  // Readers sleeping on the futex
+  std::atomic<unsigned int> closed;
+} shm_frame_header;
+
+// The sequence is 2n + 1 while frame n is written and 2n + 2 once it is
+// complete. Readers compare it before and after reading a frame in place.
+typedef struct
+{
+  std::atomic<unsigned long long> sequence;
+} shm_frame_slot;
+
+// Publishes frames into a POSIX shared memory ring for other processes. It
+// never waits for readers, a slow reader loses the oldest frames.
+class ShmRenderer : public Renderer
+{
+public:
+  ShmRenderer() : header(NULL), mappedSize(0) {};
+  void init();
+  void cleanup();
+  void update(const unsigned short *frame);
+
+private:
+  std::string name;
+  shm_frame_header *header;
+  size_t mappedSize;
+  boost::shared_ptr<FrameConverter> converter;
+
+  shm_frame_slot *getSlot(unsigned long long frame);
+  void wakeReaders();
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include <boost/assert.hpp>
+
+#include "rom_assembler.h"
+
+RomAssembler::RomAssembler(unsigned short origin, size_t size)
+:
+  origin(origin),
+  offset(0),
+  image(size, 0xFF)
+{}
+
+void RomAssembler::label(std::string name)
+{
+  BOOST_ASSERT_MSG(!labels.count(name), "Label is already placed");
+  labels[name] = getAddress();
+}
+
+void RomAssembler::put(unsigned char value)
+{
+  BOOST_ASSERT_MSG(offset < image.size(), "Program does not fit in the image");
+  image[offset++] = value;
+}
+
+void RomAssembler::reference(std::string label, bool isRelative)
+{
+  assembler_fixup fixup = { offset, label, isRelative };
+  fixups.push_back(fixup);
+  put(0);
+
+  if (!isRelative)
+  {
+    put(0);
+  }
+}
+
+void RomAssembler::emit(unsigned char opcode)
+{
+  put(opcode);
+}
+
+void RomAssembler::emit(unsigned char opcode, unsigned char operand)
+{
+  put(opcode);
+  put(operand);
+}
+
+void RomAssembler::emitAbs(unsigned char opcode, unsigned short address)
+{
+  put(opcode);
+  put(address & 0xFF);
+  put(address >> 8);
+}
+
+void RomAssembler::emitAbs(unsigned char opcode, std::string label)
+{
+  put(opcode);
+  reference(label, false);
+}
+
+void RomAssembler::branch(unsigned char opcode, std::string label)
+{
+  put(opcode);
+  reference(label, true);
+}
+
+void RomAssembler::data(const unsigned char *bytes, size_t size)
+{
+  for (size_t i = 0; i < size; i++)
+  {
+    put(bytes[i]);
+  }
+}
+
+void RomAssembler::vectors(std::string nmi, std::string reset, std::string irq)
+{
+  BOOST_ASSERT_MSG(origin + image.size() == 0x10000, "Vectors are only in the last bank");
+  offset = ADDR_VECTOR_NMI - origin;
+  reference(nmi, false);
+  reference(reset, false);
+  reference(irq, false);
+}
+
+const std::vector<unsigned char> &RomAssembler::link()
+{
+  for (std::vector<assembler_fixup>::iterator it = fixups.begin(); it != fixups.end(); ++it)
+  {
+    std::map<std::string, unsigned short>::iterator target = labels.find(it->label);
+    BOOST_ASSERT_MSG(target != labels.end(), "Label is never placed");
+
+    if (it->isRelative)
+    {
+      // Relative to the instruction after the branch
+      int distance = target->second - (origin + it->offset + 1);
+      BOOST_ASSERT_MSG(distance >= -128 && distance <= 127, "Branch target is out of range");
+      image[it->offset] = distance & 0xFF;
+    }
+    else
+    {
+      image[it->offset] = target->second & 0xFF;
+      image[it->offset + 1] = target->second >> 8;
+    }
+  }
+
+  fixups.clear();
+  return image;
+}
@@ -0,0 +1,52 @@
+#ifndef _ROM_ASSEMBLER_H_
+#define _ROM_ASSEMBLER_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include "opcodes.h"
+
+#define ADDR_VECTOR_NMI  0xFFFA
+
+typedef struct
+{
+  size_t offset;  // Of the operand in the image
+  std::string label;
+  bool isRelative;  // Branch offset instead of an absolute address
+} assembler_fixup;
+
+// Just enough of a 6502 assembler to write test programs from C++. Opcodes
+// come from opcodes.h, labels may be used before they are placed and are
+// resolved by link(). Unused space is filled with 0xFF.
+class RomAssembler
+{
+public:
+  RomAssembler(unsigned short origin, size_t size);
+
+  void label(std::string name);
+  unsigned short getAddress() { return origin + offset; };
+
+  void emit(unsigned char opcode);
+  void emit(unsigned char opcode, unsigned char operand);  // Immediate, zero page
+  void emitAbs(unsigned char opcode, unsigned short address);
+  void emitAbs(unsigned char opcode, std::string label);
+  void branch(unsigned char opcode, std::string label);
+  void data(const unsigned char *bytes, size_t size);
+
+  // Only for an image that ends at 0xFFFF
+  void vectors(std::string nmi, std::string reset, std::string irq);
+
+  const std::vector<unsigned char> &link();
+
+private:
+  unsigned short origin;
+  size_t offset;
+  std::vector<unsigned char> image;
+  std::map<std::string, unsigned short> labels;
+  std::vector<assembler_fixup> fixups;
+
+  void put(unsigned char value);
+  void reference(std::string label, bool isRelative);
+};
+
+#endif
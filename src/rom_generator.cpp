@@ -0,0 +1,704 @@
+#include <iostream>
+#include <fstream>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <boost/lexical_cast.hpp>
+
+#include "rom_generator.h"
+#include "rom_assembler.h"
+#include "ines.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "yane_exception.h"
+
+#define INES_HEADER_SIZE     16
+#define INES_PRG_UNIT        16384
+#define INES_CHR_UNIT        8192
+#define INES_VERTICAL        0x01
+
+#define ADDR_OAM_BUFFER      0x0200
+
+// Zero page of the generated programs
+#define ZP_FRAME             0x00  // Counted by the NMI handler
+#define ZP_WAIT              0x01  // Cleared by the NMI handler
+#define ZP_CONTROL           0x02  // PPUCTRL, written by the NMI handler
+#define ZP_SCROLL_X          0x03
+#define ZP_SCROLL_Y          0x04
+#define ZP_TEMP              0x05
+#define ZP_SUM               0x06
+#define ZP_SPLIT             0x07
+
+#define MMC1_CONTROL         0x8000
+#define MMC1_CHR_BANK0       0xA000
+#define MMC1_CHR_BANK1       0xC000
+#define MMC1_PRG_BANK        0xE000
+#define MMC3_BANK_SELECT     0x8000
+#define MMC3_BANK_DATA       0x8001
+#define MMC3_MIRRORING       0xA000
+#define MMC3_IRQ_LATCH       0xC000
+#define MMC3_IRQ_RELOAD      0xC001
+#define MMC3_IRQ_DISABLE     0xE000
+#define MMC3_IRQ_ENABLE      0xE001
+
+namespace romgen
+{
+  typedef struct
+  {
+    int mapper;
+    int prgBanks;  // 16 KB
+    int chrBanks;  // 8 KB
+    std::vector<unsigned char> prg;
+  } rom_layout;
+
+  static const unsigned char palette[PALETTE_RAM_SIZE] =
+  {
+    0x0F, 0x01, 0x11, 0x21, 0x0F, 0x06, 0x16, 0x26, 0x0F, 0x09, 0x19, 0x29, 0x0F, 0x0C, 0x1C, 0x2C,
+    0x0F, 0x02, 0x12, 0x22, 0x0F, 0x07, 0x17, 0x27, 0x0F, 0x0A, 0x1A, 0x2A, 0x0F, 0x14, 0x24, 0x34
+  };
+
+  // Noise from a fixed LCG, so the images never change between builds
+  static void fillNoise(unsigned char *data, size_t size, unsigned int seed)
+  {
+    for (size_t i = 0; i < size; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      data[i] = (seed >> 16) & 0xFF;
+    }
+  }
+
+  // Every seventh tile is left transparent so sprites and the background
+  // show through each other
+  static std::vector<unsigned char> makeChr(int banks)
+  {
+    std::vector<unsigned char> chr(banks * INES_CHR_UNIT);
+    fillNoise(chr.data(), chr.size(), 1);
+
+    for (size_t tile = 0; tile < chr.size() / 16; tile += 7)
+    {
+      memset(&chr[tile * 16], 0, 16);
+    }
+
+    return chr;
+  }
+
+  static void makeSprites(unsigned char *oam)
+  {
+    for (int i = 0; i < SPRITE_RAM_SIZE / SPRITE_ENTRY_SIZE; i++)
+    {
+      unsigned char *sprite = oam + i * SPRITE_ENTRY_SIZE;
+      sprite[0] = (i * 7) & 0x7F;  // Many on the same lines
+      sprite[1] = (i * 2 + 1) & 0xFF;
+      sprite[2] = (i * 13) & 0xE3;
+      sprite[3] = (i * 37 + 11) & 0xFF;
+    }
+  }
+
+  static void emitMmc1Write(RomAssembler &a, unsigned short address)
+  {
+    for (int i = 0; i < 5; i++)
+    {
+      a.emitAbs(STA_ABS, address);
+      a.emit(LSR_ACC);
+    }
+  }
+
+  static void emitWaitVblank(RomAssembler &a, std::string name)
+  {
+    a.label(name);
+    a.emitAbs(BIT_ABS, ADDR_PPU_STATUS);
+    a.branch(BPL, name);
+  }
+
+  static void emitWaitNmi(RomAssembler &a, std::string name)
+  {
+    a.emit(LDA_IMM, 1);
+    a.emit(STA_ZERO, ZP_WAIT);
+    a.label(name);
+    a.emit(LDA_ZERO, ZP_WAIT);
+    a.branch(BNE, name);
+  }
+
+  // Power on: clears RAM, loads the palette, fills both name tables and
+  // copies the sprites to the OAM buffer. Rendering stays off.
+  static void emitReset(RomAssembler &a)
+  {
+    a.label("reset");
+    a.emit(SEI);
+    a.emit(CLD);
+    a.emit(LDX_IMM, 0xFF);
+    a.emit(TXS);
+    a.emit(INX);
+    a.emitAbs(STX_ABS, ADDR_PPU_CONTROL);
+    a.emitAbs(STX_ABS, ADDR_PPU_MASK);
+    emitWaitVblank(a, "vblank1");
+
+    a.emit(LDA_IMM, 0);
+    a.label("clear");
+
+    for (int page = 0; page < 8; page++)
+    {
+      a.emitAbs(STA_ABS_X, page * 0x100);
+    }
+
+    a.emit(INX);
+    a.branch(BNE, "clear");
+    emitWaitVblank(a, "vblank2");
+
+    a.emit(LDA_IMM, ADDR_PALETTE_BG >> 8);
+    a.emitAbs(STA_ABS, ADDR_PPU_ADDR);
+    a.emit(LDA_IMM, ADDR_PALETTE_BG & 0xFF);
+    a.emitAbs(STA_ABS, ADDR_PPU_ADDR);
+    a.emit(LDX_IMM, 0);
+    a.label("palette");
+    a.emitAbs(LDA_ABS_X, "paletteData");
+    a.emitAbs(STA_ABS, ADDR_PPU_DATA);
+    a.emit(INX);
+    a.emit(CPX_IMM, PALETTE_RAM_SIZE);
+    a.branch(BNE, "palette");
+
+    a.emit(LDA_IMM, 0x20);
+    a.emitAbs(STA_ABS, ADDR_PPU_ADDR);
+    a.emit(LDA_IMM, 0x00);
+    a.emitAbs(STA_ABS, ADDR_PPU_ADDR);
+    a.emit(LDY_IMM, 2 * NAME_TABLE_BYTES / 256);
+    a.label("nameTables");
+    a.emit(TXA);
+    a.emit(CLC);
+    a.emit(ADC_ZERO, ZP_TEMP);
+    a.emitAbs(STA_ABS, ADDR_PPU_DATA);
+    a.emit(INX);
+    a.branch(BNE, "nameTables");
+    a.emit(INC_ZERO, ZP_TEMP);
+    a.emit(INC_ZERO, ZP_TEMP);
+    a.emit(INC_ZERO, ZP_TEMP);
+    a.emit(DEY);
+    a.branch(BNE, "nameTables");
+
+    a.label("sprites");
+    a.emitAbs(LDA_ABS_X, "spriteData");
+    a.emitAbs(STA_ABS_X, ADDR_OAM_BUFFER);
+    a.emit(INX);
+    a.branch(BNE, "sprites");
+  }
+
+  // Turns on NMIs and rendering with the given PPUCTRL
+  static void emitStart(RomAssembler &a, unsigned char control)
+  {
+    a.emit(LDA_IMM, control);
+    a.emit(STA_ZERO, ZP_CONTROL);
+    a.emitAbs(STA_ABS, ADDR_PPU_CONTROL);
+    a.emit(LDA_IMM, PPU_MASK_BG_LEFT | PPU_MASK_SPRITE_LEFT | PPU_MASK_SHOW_BG | PPU_MASK_SHOW_SPRITES);
+    a.emitAbs(STA_ABS, ADDR_PPU_MASK);
+  }
+
+  static void emitNmiStart(RomAssembler &a, bool hasDma)
+  {
+    a.label("nmi");
+    a.emit(PHA);
+    a.emit(TXA);
+    a.emit(PHA);
+    a.emit(TYA);
+    a.emit(PHA);
+
+    if (hasDma)
+    {
+      a.emit(LDA_IMM, 0);
+      a.emitAbs(STA_ABS, ADDR_PPU_OAM_ADDR);
+      a.emit(LDA_IMM, ADDR_OAM_BUFFER >> 8);
+      a.emitAbs(STA_ABS, ADDR_DMA);
+    }
+  }
+
+  static void emitNmiEnd(RomAssembler &a)
+  {
+    a.emit(LDA_ZERO, ZP_SCROLL_X);
+    a.emitAbs(STA_ABS, ADDR_PPU_SCROLL);
+    a.emit(LDA_ZERO, ZP_SCROLL_Y);
+    a.emitAbs(STA_ABS, ADDR_PPU_SCROLL);
+    a.emit(LDA_ZERO, ZP_CONTROL);
+    a.emitAbs(STA_ABS, ADDR_PPU_CONTROL);
+    a.emit(INC_ZERO, ZP_FRAME);
+    a.emit(LDA_IMM, 0);
+    a.emit(STA_ZERO, ZP_WAIT);
+    a.emit(PLA);
+    a.emit(TAY);
+    a.emit(PLA);
+    a.emit(TAX);
+    a.emit(PLA);
+    a.label("irq");
+    a.emit(RTI);
+  }
+
+  static void emitTables(RomAssembler &a)
+  {
+    unsigned char sprites[SPRITE_RAM_SIZE];
+    makeSprites(sprites);
+
+    a.label("paletteData");
+    a.data(palette, sizeof(palette));
+    a.label("spriteData");
+    a.data(sprites, sizeof(sprites));
+  }
+
+  // Switchable banks hold noise for the program to read
+  static void appendDataBanks(rom_layout &rom, size_t size)
+  {
+    size_t start = rom.prg.size();
+    rom.prg.resize(start + size);
+    fillNoise(&rom.prg[start], size, 2);
+  }
+
+  static void appendCode(rom_layout &rom, RomAssembler &a)
+  {
+    a.vectors("nmi", "reset", "irq");
+    const std::vector<unsigned char> &code = a.link();
+    rom.prg.insert(rom.prg.end(), code.begin(), code.end());
+  }
+
+  // Mixed arithmetic on zero page arrays, the CPU never waits for the PPU.
+  // The results end up in the scroll position so they are seen in frames.
+  static void buildAluLoop(rom_layout &rom)
+  {
+    RomAssembler a(0xC000, INES_PRG_UNIT);
+    emitReset(a);
+    emitStart(a, 0x80);
+
+    a.label("main");
+    a.emit(LDX_IMM, 0);
+    a.label("alu");
+    a.emit(LDA_ZERO_X, 0x10);
+    a.emit(ADC_ZERO_X, 0x11);
+    a.emit(STA_ZERO_X, 0x10);
+    a.emit(XOR_ZERO, ZP_FRAME);
+    a.emit(ROL_ACC);
+    a.emit(ADC_IMM, 0x3B);
+    a.emit(STA_ZERO_X, 0x11);
+    a.emit(LSR_ZERO_X, 0x12);
+    a.emit(ROR_ZERO_X, 0x13);
+    a.emit(SBC_ZERO_X, 0x14);
+    a.emit(STA_ZERO_X, 0x14);
+    a.emit(AND_IMM, 0x7F);
+    a.emit(OR_ZERO_X, 0x15);
+    a.emit(CMP_ZERO_X, 0x16);
+    a.emit(INX);
+    a.emit(CPX_IMM, 0xE0);
+    a.branch(BNE, "alu");
+    a.emit(LDA_ZERO, 0x10);
+    a.emit(STA_ZERO, ZP_SCROLL_X);
+    a.emitAbs(JMP_ABS, "main");
+
+    emitNmiStart(a, true);
+    emitNmiEnd(a);
+    emitTables(a);
+
+    rom.mapper = 0;
+    rom.prgBanks = 1;
+    rom.chrBanks = 1;
+    appendCode(rom, a);
+  }
+
+  // Rewrites a strip of the name table and the whole palette through $2007
+  // in every vblank
+  static void buildVramUpload(rom_layout &rom)
+  {
+    RomAssembler a(0xC000, INES_PRG_UNIT);
+    emitReset(a);
+    emitStart(a, 0x80);
+
+    a.label("main");
+    a.emit(INC_ZERO, ZP_SUM);
+    a.emitAbs(JMP_ABS, "main");
+
+    // Without sprite DMA there is time for 96 name table bytes
+    emitNmiStart(a, false);
+    a.emit(LDA_ZERO, ZP_FRAME);
+    a.emit(AND_IMM, 0x07);
+    a.emit(TAX);
+    a.emitAbs(LDA_ABS_X, "rowHigh");
+    a.emitAbs(STA_ABS, ADDR_PPU_ADDR);
+    a.emitAbs(LDA_ABS_X, "rowLow");
+    a.emitAbs(STA_ABS, ADDR_PPU_ADDR);
+    a.emit(LDX_IMM, 96);
+    a.label("upload");
+    a.emit(TXA);
+    a.emit(ADC_ZERO, ZP_FRAME);
+    a.emitAbs(STA_ABS, ADDR_PPU_DATA);
+    a.emit(DEX);
+    a.branch(BNE, "upload");
+
+    a.emit(LDA_IMM, ADDR_PALETTE_BG >> 8);
+    a.emitAbs(STA_ABS, ADDR_PPU_ADDR);
+    a.emit(LDA_IMM, ADDR_PALETTE_BG & 0xFF);
+    a.emitAbs(STA_ABS, ADDR_PPU_ADDR);
+    a.emit(LDX_IMM, 0);
+    a.label("uploadPalette");
+    a.emitAbs(LDA_ABS_X, "paletteData");
+    a.emit(ADC_ZERO, ZP_FRAME);
+    a.emit(AND_IMM, 0x3F);
+    a.emitAbs(STA_ABS, ADDR_PPU_DATA);
+    a.emit(INX);
+    a.emit(CPX_IMM, PALETTE_RAM_SIZE);
+    a.branch(BNE, "uploadPalette");
+    emitNmiEnd(a);
+    emitTables(a);
+
+    // Every fourth row of the first name table
+    unsigned char high[8], low[8];
+
+    for (int i = 0; i < 8; i++)
+    {
+      unsigned short address = 0x2000 + i * 4 * NAME_TABLE_WIDTH;
+      high[i] = address >> 8;
+      low[i] = address & 0xFF;
+    }
+
+    a.label("rowHigh");
+    a.data(high, sizeof(high));
+    a.label("rowLow");
+    a.data(low, sizeof(low));
+
+    rom.mapper = 0;
+    rom.prgBanks = 1;
+    rom.chrBanks = 1;
+    appendCode(rom, a);
+  }
+
+  // All 64 sprites in 8x16 mode move every frame, many share scanlines so
+  // the sprite overflow flag is set
+  static void buildSprites8x16(rom_layout &rom)
+  {
+    RomAssembler a(0xC000, INES_PRG_UNIT);
+    emitReset(a);
+    emitStart(a, 0xA0);
+
+    a.label("main");
+    emitWaitNmi(a, "wait");
+    a.emit(LDX_IMM, 0);
+    a.label("move");
+    a.emit(TXA);
+    a.emit(LSR_ACC);
+    a.emit(LSR_ACC);
+    a.emit(AND_IMM, 0x03);
+    a.emit(SEC);
+    a.emitAbs(ADC_ABS_X, ADDR_OAM_BUFFER + 3);
+    a.emitAbs(STA_ABS_X, ADDR_OAM_BUFFER + 3);
+    a.emitAbs(INC_ABS_X, ADDR_OAM_BUFFER);
+    a.emitAbs(LDA_ABS_X, ADDR_OAM_BUFFER + 1);
+    a.emit(CLC);
+    a.emit(ADC_IMM, 2);
+    a.emitAbs(STA_ABS_X, ADDR_OAM_BUFFER + 1);
+    a.emit(INX);
+    a.emit(INX);
+    a.emit(INX);
+    a.emit(INX);
+    a.branch(BNE, "move");
+    a.emitAbs(JMP_ABS, "main");
+
+    emitNmiStart(a, true);
+    emitNmiEnd(a);
+    emitTables(a);
+
+    rom.mapper = 0;
+    rom.prgBanks = 1;
+    rom.chrBanks = 1;
+    appendCode(rom, a);
+  }
+
+  // Waits for sprite 0 and then changes the horizontal scroll every eight
+  // scanlines, 20 times a frame
+  static void buildScrollSplits(rom_layout &rom)
+  {
+    RomAssembler a(0xC000, INES_PRG_UNIT);
+    emitReset(a);
+
+    // Sprite 0 over the noise of the name table
+    a.emit(LDA_IMM, 20);
+    a.emitAbs(STA_ABS, ADDR_OAM_BUFFER);
+    a.emit(LDA_IMM, 1);
+    a.emitAbs(STA_ABS, ADDR_OAM_BUFFER + 1);
+    a.emit(LDA_IMM, 0);
+    a.emitAbs(STA_ABS, ADDR_OAM_BUFFER + 2);
+    a.emit(LDA_IMM, 128);
+    a.emitAbs(STA_ABS, ADDR_OAM_BUFFER + 3);
+    emitStart(a, 0x80);
+
+    a.label("main");
+    emitWaitNmi(a, "wait");
+    a.label("hitCleared");
+    a.emitAbs(BIT_ABS, ADDR_PPU_STATUS);
+    a.branch(BVS, "hitCleared");
+    a.label("hit");
+    a.emitAbs(BIT_ABS, ADDR_PPU_STATUS);
+    a.branch(BVC, "hit");
+
+    a.emit(LDX_IMM, 0);
+    a.label("split");
+    a.emit(LDY_IMM, 180);  // About eight scanlines
+    a.label("delay");
+    a.emit(DEY);
+    a.branch(BNE, "delay");
+    a.emit(TXA);
+    a.emit(ASL_ACC);
+    a.emit(ASL_ACC);
+    a.emit(CLC);
+    a.emit(ADC_ZERO, ZP_FRAME);
+    a.emitAbs(STA_ABS, ADDR_PPU_SCROLL);
+    a.emit(LDA_IMM, 0);
+    a.emitAbs(STA_ABS, ADDR_PPU_SCROLL);
+    a.emit(INX);
+    a.emit(CPX_IMM, 20);
+    a.branch(BNE, "split");
+    a.emitAbs(JMP_ABS, "main");
+
+    emitNmiStart(a, true);
+    emitNmiEnd(a);
+    emitTables(a);
+
+    rom.mapper = 0;
+    rom.prgBanks = 1;
+    rom.chrBanks = 1;
+    appendCode(rom, a);
+  }
+
+  // MMC3 scanline IRQs every 32 lines change the scroll and the background
+  // CHR bank, like a status bar. The main loop sums the switchable PRG banks.
+  static void buildMmc3StatusBar(rom_layout &rom)
+  {
+    // Banks 6 and 7 are fixed at $C000 and $E000
+    appendDataBanks(rom, 3 * INES_PRG_UNIT);
+    RomAssembler a(0xC000, INES_PRG_UNIT);
+    emitReset(a);
+
+    a.emit(LDA_IMM, 0);
+    a.emitAbs(STA_ABS, MMC3_MIRRORING);
+    a.emitAbs(STA_ABS, MMC3_IRQ_DISABLE);
+    a.emit(LDX_IMM, 0);
+    a.label("chrBanks");
+    a.emit(TXA);
+    a.emitAbs(STA_ABS, MMC3_BANK_SELECT);
+    a.emitAbs(LDA_ABS_X, "chrBankData");
+    a.emitAbs(STA_ABS, MMC3_BANK_DATA);
+    a.emit(INX);
+    a.emit(CPX_IMM, 6);
+    a.branch(BNE, "chrBanks");
+
+    // Sprites from $1000 so A12 rises once per line
+    emitStart(a, 0x88);
+    a.emit(CLI);
+
+    a.label("main");
+    a.emit(LDY_IMM, 0);
+    a.label("bank");
+    a.emit(SEI);
+    a.emit(LDA_IMM, 6);
+    a.emitAbs(STA_ABS, MMC3_BANK_SELECT);
+    a.emit(STY_ZERO, ZP_TEMP);
+    a.emitAbs(STY_ABS, MMC3_BANK_DATA);
+    a.emit(CLI);
+    a.emit(LDX_IMM, 0);
+    a.emit(LDA_ZERO, ZP_SUM);
+    a.label("sum");
+    a.emitAbs(ADC_ABS_X, 0x8000);
+    a.emitAbs(XOR_ABS_X, 0x8100);
+    a.emit(INX);
+    a.branch(BNE, "sum");
+    a.emit(STA_ZERO, ZP_SUM);
+    a.emit(INY);
+    a.emit(CPY_IMM, 6);
+    a.branch(BNE, "bank");
+    a.emitAbs(STA_ABS, ADDR_OAM_BUFFER);
+    a.emitAbs(JMP_ABS, "main");
+
+    emitNmiStart(a, true);
+    a.emit(LDA_IMM, 0);
+    a.emit(STA_ZERO, ZP_SPLIT);
+    a.emitAbs(STA_ABS, MMC3_BANK_SELECT);
+    a.emitAbs(STA_ABS, MMC3_BANK_DATA);
+    a.emit(LDA_IMM, 31);
+    a.emitAbs(STA_ABS, MMC3_IRQ_LATCH);
+    a.emitAbs(STA_ABS, MMC3_IRQ_RELOAD);
+    a.emitAbs(STA_ABS, MMC3_IRQ_DISABLE);
+    a.emitAbs(STA_ABS, MMC3_IRQ_ENABLE);
+    a.emit(LDA_IMM, 6);
+    a.emitAbs(STA_ABS, MMC3_BANK_SELECT);
+    a.emit(LDA_ZERO, ZP_TEMP);
+    a.emitAbs(STA_ABS, MMC3_BANK_DATA);
+    emitNmiEnd(a);
+
+    // The main loop keeps the PRG bank in ZP_TEMP, so the bank select can be
+    // put back after switching CHR
+    a.label("mmc3Irq");
+    a.emit(PHA);
+    a.emitAbs(STA_ABS, MMC3_IRQ_DISABLE);
+    a.emitAbs(STA_ABS, MMC3_IRQ_ENABLE);
+    a.emit(INC_ZERO, ZP_SPLIT);
+    a.emit(LDA_ZERO, ZP_SPLIT);
+    a.emit(ASL_ACC);
+    a.emit(ASL_ACC);
+    a.emit(ASL_ACC);
+    a.emit(ADC_ZERO, ZP_FRAME);
+    a.emitAbs(STA_ABS, ADDR_PPU_SCROLL);
+    a.emit(LDA_IMM, 0);
+    a.emitAbs(STA_ABS, ADDR_PPU_SCROLL);
+    a.emitAbs(STA_ABS, MMC3_BANK_SELECT);
+    a.emit(LDA_ZERO, ZP_SPLIT);
+    a.emit(ASL_ACC);
+    a.emit(AND_IMM, 0x1E);
+    a.emitAbs(STA_ABS, MMC3_BANK_DATA);
+    a.emit(LDA_IMM, 6);
+    a.emitAbs(STA_ABS, MMC3_BANK_SELECT);
+    a.emit(LDA_ZERO, ZP_TEMP);
+    a.emitAbs(STA_ABS, MMC3_BANK_DATA);
+    a.emit(PLA);
+    a.emit(RTI);
+    emitTables(a);
+
+    static const unsigned char chrBanks[6] = { 0, 2, 16, 17, 18, 19 };
+    a.label("chrBankData");
+    a.data(chrBanks, sizeof(chrBanks));
+
+    a.vectors("nmi", "reset", "mmc3Irq");
+    const std::vector<unsigned char> &code = a.link();
+    rom.prg.insert(rom.prg.end(), code.begin(), code.end());
+
+    rom.mapper = 4;
+    rom.prgBanks = 4;
+    rom.chrBanks = 4;
+  }
+
+  // MMC1 PRG and CHR banks are switched many times per frame through the
+  // serial port, the main loop reads every switchable PRG bank
+  static void buildBankSwitching(rom_layout &rom)
+  {
+    appendDataBanks(rom, 7 * INES_PRG_UNIT);
+    RomAssembler a(0xC000, INES_PRG_UNIT);
+    emitReset(a);
+
+    // 16 KB PRG banks with the last one fixed, 4 KB CHR banks, vertical
+    // mirroring
+    a.emit(LDA_IMM, 0x80);
+    a.emitAbs(STA_ABS, MMC1_CONTROL);
+    a.emit(LDA_IMM, 0x1E);
+    emitMmc1Write(a, MMC1_CONTROL);
+    emitStart(a, 0x80);
+
+    a.label("main");
+    emitWaitNmi(a, "wait");
+    a.emit(LDA_ZERO, ZP_FRAME);
+    a.emit(AND_IMM, 0x0F);
+    emitMmc1Write(a, MMC1_CHR_BANK0);
+    a.emit(LDA_ZERO, ZP_FRAME);
+    a.emit(XOR_IMM, 0x0F);
+    a.emit(AND_IMM, 0x0F);
+    emitMmc1Write(a, MMC1_CHR_BANK1);
+
+    a.emit(LDY_IMM, 0);
+    a.label("bank");
+    a.emit(TYA);
+    emitMmc1Write(a, MMC1_PRG_BANK);
+    a.emit(LDX_IMM, 0);
+    a.emit(LDA_ZERO, ZP_SUM);
+    a.label("sum");
+    a.emitAbs(XOR_ABS_X, 0x8000);
+    a.emitAbs(ADC_ABS_X, 0xBF00);
+    a.emit(INX);
+    a.branch(BNE, "sum");
+    a.emit(STA_ZERO, ZP_SUM);
+    a.emit(INY);
+    a.emit(CPY_IMM, 7);
+    a.branch(BNE, "bank");
+    a.emit(STA_ZERO, ZP_SCROLL_Y);
+    a.emitAbs(JMP_ABS, "main");
+
+    emitNmiStart(a, true);
+    emitNmiEnd(a);
+    emitTables(a);
+
+    rom.mapper = 1;
+    rom.prgBanks = 8;
+    rom.chrBanks = 8;
+    appendCode(rom, a);
+  }
+
+  std::vector<unsigned char> generate(enum RomWorkload workload)
+  {
+    rom_layout rom;
+
+    switch (workload)
+    {
+      case RomWorkload::AluLoop:
+        buildAluLoop(rom);
+        break;
+
+      case RomWorkload::VramUpload:
+        buildVramUpload(rom);
+        break;
+
+      case RomWorkload::Sprites8x16:
+        buildSprites8x16(rom);
+        break;
+
+      case RomWorkload::ScrollSplits:
+        buildScrollSplits(rom);
+        break;
+
+      case RomWorkload::Mmc3StatusBar:
+        buildMmc3StatusBar(rom);
+        break;
+
+      case RomWorkload::BankSwitching:
+        buildBankSwitching(rom);
+        break;
+
+      default:
+        return std::vector<unsigned char>();
+    }
+
+    std::vector<unsigned char> chr = makeChr(rom.chrBanks);
+    std::vector<unsigned char> image(INES_HEADER_SIZE, 0);
+    memcpy(image.data(), INES_PREAMBLE, 3);
+    image[3] = INES_DELIMITER;
+    image[4] = rom.prgBanks;
+    image[5] = rom.chrBanks;
+    image[6] = ((rom.mapper & 0x0F) << 4) | INES_VERTICAL;
+    image[7] = rom.mapper & 0xF0;
+    image.insert(image.end(), rom.prg.begin(), rom.prg.end());
+    image.insert(image.end(), chr.begin(), chr.end());
+    return image;
+  }
+
+  void writeRom(std::string filename, enum RomWorkload workload)
+  {
+    std::vector<unsigned char> image = generate(workload);
+    std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write((const char*)image.data(), image.size());
+    file.close();
+
+    if (!file)
+    {
+      throw RomGeneratorException(filename, strerror(errno));
+    }
+  }
+
+  void writeCorpus(std::string directory)
+  {
+    mkdir(directory.c_str(), 0755);
+
+    for (int i = 0; i < RomWorkloadCount; i++)
+    {
+      std::string filename = directory + "/" + romWorkloadNames[i] + ".nes";
+      writeRom(filename, (enum RomWorkload)i);
+
+      iNes rom(filename);
+      rom.init();
+
+      if (!rom.isValid())
+      {
+        throw RomGeneratorException(filename, "Not loadable as an iNES rom");
+      }
+
+      std::cout << "Wrote " << filename << ": mapper " << rom.getMapperId() << ", " << rom.getPrgRomCount() * PRG_BANK_SIZE / 1024 << " KB PRG, " << rom.getChrRomCount() * CHR_BANK_SIZE / 1024 << " KB CHR" << std::endl;
+    }
+  }
+}
@@ -0,0 +1,23 @@
+#ifndef _ROM_GENERATOR_H_
+#define _ROM_GENERATOR_H_
+
+#include <string>
+#include <vector>
+
+enum RomWorkload { AluLoop, VramUpload, Sprites8x16, ScrollSplits, Mmc3StatusBar, BankSwitching, RomWorkloadCount };
+
+static const char * const romWorkloadNames[RomWorkloadCount] = { "alu", "vram", "sprites", "scroll", "mmc3-irq", "banks" };
+
+// Synthetic iNes images for benchmarks, since commercial roms can not be
+// shipped. Every image stresses one part of the emulator and is built from
+// code only, so the same build always generates the same bytes.
+namespace romgen
+{
+  std::vector<unsigned char> generate(enum RomWorkload workload);
+  void writeRom(std::string filename, enum RomWorkload workload);
+
+  // Writes <name>.nes for every workload, each is loaded back as a check
+  void writeCorpus(std::string directory);
+}
+
+#endif
@@ -0,0 +1,358 @@
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "scaler.h"
+
+// Thresholds in YUV for pixels that look alike, the ones hq2x uses
+#define SIMILAR_Y  48
+#define SIMILAR_U  7
+#define SIMILAR_V  6
+
+// Channel access for the two supported pixel formats
+template<typename Pixel> struct pixel_traits;
+
+template<> struct pixel_traits<unsigned short>
+{
+  static int r(unsigned short p) { return ((p >> 11) & 0x1F) << 3; }
+  static int g(unsigned short p) { return ((p >> 5) & 0x3F) << 2; }
+  static int b(unsigned short p) { return (p & 0x1F) << 3; }
+  static unsigned short average(unsigned short a, unsigned short b) { return (((a ^ b) & 0xF7DE) >> 1) + (a & b); }
+};
+
+template<> struct pixel_traits<unsigned int>
+{
+  static int r(unsigned int p) { return (p >> 16) & 0xFF; }
+  static int g(unsigned int p) { return (p >> 8) & 0xFF; }
+  static int b(unsigned int p) { return p & 0xFF; }
+  static unsigned int average(unsigned int a, unsigned int b) { return (((a ^ b) & 0xFEFEFE) >> 1) + (a & b); }
+};
+
+template<typename Pixel>
+static bool isSimilar(Pixel a, Pixel b)
+{
+  if (a == b)
+  {
+    return true;
+  }
+
+  typedef pixel_traits<Pixel> T;
+  int r = T::r(a) - T::r(b), g = T::g(a) - T::g(b), b2 = T::b(a) - T::b(b);
+
+  return abs((r + g + b2) >> 2) <= SIMILAR_Y &&
+    abs((r - b2) >> 2) <= SIMILAR_U &&
+    abs((-r + 2 * g - b2) >> 3) <= SIMILAR_V;
+}
+
+// Scale2x (AdvMAME2x) of pixels [from, to) of a row
+template<typename Pixel>
+static void scale2xPixels(const Pixel *above, const Pixel *row, const Pixel *below, int width, int from, int to, Pixel *out0, Pixel *out1)
+{
+  for (int x = from; x < to; x++)
+  {
+    Pixel B = above[x], H = below[x], E = row[x];
+    Pixel D = row[x > 0 ? x - 1 : 0], F = row[x < width - 1 ? x + 1 : x];
+
+    if (B != H && D != F)
+    {
+      out0[2 * x] = D == B ? D : E;
+      out0[2 * x + 1] = B == F ? F : E;
+      out1[2 * x] = D == H ? D : E;
+      out1[2 * x + 1] = H == F ? F : E;
+    }
+    else
+    {
+      out0[2 * x] = out0[2 * x + 1] = out1[2 * x] = out1[2 * x + 1] = E;
+    }
+  }
+}
+
+template<typename Pixel>
+static void scale2xRow(const Pixel *above, const Pixel *row, const Pixel *below, int width, Pixel **out)
+{
+  scale2xPixels(above, row, below, width, 0, width, out[0], out[1]);
+}
+
+#ifdef __SSE2__
+static inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Four pixels at a time, the edge pixels need clamped neighbors
+template<>
+void scale2xRow<unsigned int>(const unsigned int *above, const unsigned int *row, const unsigned int *below, int width, unsigned int **out)
+{
+  int x = 1;
+
+  scale2xPixels(above, row, below, width, 0, 1, out[0], out[1]);
+
+  for (; x + 4 <= width - 1; x += 4)
+  {
+    __m128i B = _mm_loadu_si128((const __m128i*)(above + x));
+    __m128i H = _mm_loadu_si128((const __m128i*)(below + x));
+    __m128i D = _mm_loadu_si128((const __m128i*)(row + x - 1));
+    __m128i E = _mm_loadu_si128((const __m128i*)(row + x));
+    __m128i F = _mm_loadu_si128((const __m128i*)(row + x + 1));
+    __m128i active = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi32(B, H), _mm_cmpeq_epi32(D, F)), _mm_set1_epi32(-1));
+
+    __m128i E0 = select(_mm_and_si128(active, _mm_cmpeq_epi32(D, B)), D, E);
+    __m128i E1 = select(_mm_and_si128(active, _mm_cmpeq_epi32(B, F)), F, E);
+    __m128i E2 = select(_mm_and_si128(active, _mm_cmpeq_epi32(D, H)), D, E);
+    __m128i E3 = select(_mm_and_si128(active, _mm_cmpeq_epi32(H, F)), F, E);
+
+    _mm_storeu_si128((__m128i*)(out[0] + 2 * x), _mm_unpacklo_epi32(E0, E1));
+    _mm_storeu_si128((__m128i*)(out[0] + 2 * x + 4), _mm_unpackhi_epi32(E0, E1));
+    _mm_storeu_si128((__m128i*)(out[1] + 2 * x), _mm_unpacklo_epi32(E2, E3));
+    _mm_storeu_si128((__m128i*)(out[1] + 2 * x + 4), _mm_unpackhi_epi32(E2, E3));
+  }
+
+  scale2xPixels(above, row, below, width, x, width, out[0], out[1]);
+}
+#endif
+
+// Scale3x (AdvMAME3x)
+template<typename Pixel>
+static void scale3xRow(const Pixel *above, const Pixel *row, const Pixel *below, int width, Pixel **out)
+{
+  for (int x = 0; x < width; x++)
+  {
+    int left = x > 0 ? x - 1 : 0, right = x < width - 1 ? x + 1 : x;
+    Pixel A = above[left], B = above[x], C = above[right];
+    Pixel D = row[left], E = row[x], F = row[right];
+    Pixel G = below[left], H = below[x], I = below[right];
+    Pixel *o0 = out[0] + 3 * x, *o1 = out[1] + 3 * x, *o2 = out[2] + 3 * x;
+
+    if (B != H && D != F)
+    {
+      o0[0] = D == B ? D : E;
+      o0[1] = (D == B && E != C) || (B == F && E != A) ? B : E;
+      o0[2] = B == F ? F : E;
+      o1[0] = (D == B && E != G) || (D == H && E != A) ? D : E;
+      o1[1] = E;
+      o1[2] = (B == F && E != I) || (H == F && E != C) ? F : E;
+      o2[0] = D == H ? D : E;
+      o2[1] = (D == H && E != I) || (H == F && E != G) ? H : E;
+      o2[2] = H == F ? F : E;
+    }
+    else
+    {
+      o0[0] = o0[1] = o0[2] = o1[0] = o1[1] = o1[2] = o2[0] = o2[1] = o2[2] = E;
+    }
+  }
+}
+
+// Scale2x decisions on similar instead of equal colors, and corners blended
+// with the neighbors instead of replaced by them. Not hq2x, which picks one
+// of its interpolations per pattern of all eight neighbors.
+template<typename Pixel>
+static void scale2xSmoothRow(const Pixel *above, const Pixel *row, const Pixel *below, int width, Pixel **out)
+{
+  typedef pixel_traits<Pixel> T;
+
+  for (int x = 0; x < width; x++)
+  {
+    Pixel B = above[x], H = below[x], E = row[x];
+    Pixel D = row[x > 0 ? x - 1 : 0], F = row[x < width - 1 ? x + 1 : x];
+    Pixel E0 = E, E1 = E, E2 = E, E3 = E;
+
+    if (!isSimilar(B, H) && !isSimilar(D, F))
+    {
+      if (isSimilar(D, B)) E0 = T::average(E, T::average(D, B));
+      if (isSimilar(B, F)) E1 = T::average(E, T::average(B, F));
+      if (isSimilar(D, H)) E2 = T::average(E, T::average(D, H));
+      if (isSimilar(H, F)) E3 = T::average(E, T::average(H, F));
+    }
+
+    out[0][2 * x] = E0;
+    out[0][2 * x + 1] = E1;
+    out[1][2 * x] = E2;
+    out[1][2 * x + 1] = E3;
+  }
+}
+
+// Repeat every pixel `factor` times
+template<typename Pixel>
+static void expandRow(const Pixel *row, int width, int factor, Pixel *out)
+{
+  if (factor == 1)
+  {
+    memcpy(out, row, width * sizeof(Pixel));
+    return;
+  }
+
+  for (int x = 0; x < width; x++)
+  {
+    for (int i = 0; i < factor; i++)
+    {
+      *out++ = row[x];
+    }
+  }
+}
+
+#ifdef __SSE2__
+template<>
+void expandRow<unsigned int>(const unsigned int *row, int width, int factor, unsigned int *out)
+{
+  if (factor == 1)
+  {
+    memcpy(out, row, width * sizeof(unsigned int));
+    return;
+  }
+
+  if (factor == 2)
+  {
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4, out += 8)
+    {
+      __m128i pixels = _mm_loadu_si128((const __m128i*)(row + x));
+      _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi32(pixels, pixels));
+      _mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi32(pixels, pixels));
+    }
+
+    for (; x < width; x++)
+    {
+      *out++ = row[x];
+      *out++ = row[x];
+    }
+
+    return;
+  }
+
+  // Broadcast stores, the next pixel overwrites the overlap
+  for (int x = 0; x < width - 1; x++, out += factor)
+  {
+    __m128i pixel = _mm_set1_epi32(row[x]);
+
+    for (int i = 0; i < factor; i += 4)
+    {
+      _mm_storeu_si128((__m128i*)(out + i), pixel);
+    }
+  }
+
+  for (int i = 0; i < factor; i++)
+  {
+    out[i] = row[width - 1];
+  }
+}
+#endif
+
+template<typename Pixel>
+static void scaleRows(
+  const Pixel *source,
+  int width,
+  int height,
+  int from,
+  int to,
+  enum ScaleFilter filter,
+  int filterScale,
+  int factor,
+  Pixel *rowBuffer,
+  unsigned char *output,
+  int pitch)
+{
+  int filteredWidth = width * filterScale;
+  int outputWidth = filteredWidth * factor;
+  Pixel *filtered[3] = { rowBuffer, rowBuffer + filteredWidth, rowBuffer + 2 * filteredWidth };
+
+  for (int y = from; y < to; y++)
+  {
+    const Pixel *row = source + y * width;
+    const Pixel *above = y > 0 ? row - width : row;
+    const Pixel *below = y < height - 1 ? row + width : row;
+
+    switch (filter)
+    {
+    case ScaleFilter::Nearest:
+      filtered[0] = (Pixel*)row;
+      break;
+
+    case ScaleFilter::Scale2x:
+      scale2xRow(above, row, below, width, filtered);
+      break;
+
+    case ScaleFilter::Scale3x:
+      scale3xRow(above, row, below, width, filtered);
+      break;
+
+    case ScaleFilter::Scale2xSmooth:
+      scale2xSmoothRow(above, row, below, width, filtered);
+      break;
+    }
+
+    // Expand each filtered row once, then copy it down
+    for (int i = 0; i < filterScale; i++)
+    {
+      unsigned char *out = output + (y * filterScale + i) * factor * pitch;
+      expandRow(filtered[i], filteredWidth, factor, (Pixel*)out);
+
+      for (int copy = 1; copy < factor; copy++)
+      {
+        memcpy(out + copy * pitch, out, outputWidth * sizeof(Pixel));
+      }
+    }
+  }
+}
+
+Scaler::Scaler(int pixelSize, int width, int height, enum ScaleFilter filter, int factor, boost::shared_ptr<BandWorkers> workers)
+:
+  pixelSize(pixelSize),
+  width(width),
+  height(height),
+  filter(filter),
+  filterScale(getFilterScale(filter)),
+  factor(factor),
+  source(NULL),
+  output(NULL),
+  pitch(0),
+  workers(workers)
+{
+  rowBuffers.resize(workers->getBands(), std::vector<unsigned char>(3 * width * filterScale * pixelSize));
+}
+
+int Scaler::getFilterScale(enum ScaleFilter filter)
+{
+  switch (filter)
+  {
+  case ScaleFilter::Scale2x:
+  case ScaleFilter::Scale2xSmooth:
+    return 2;
+
+  case ScaleFilter::Scale3x:
+    return 3;
+
+  default:
+    return 1;
+  }
+}
+
+void Scaler::scale(const unsigned char *source, unsigned char *output, int pitch)
+{
+  this->source = source;
+  this->output = output;
+  this->pitch = pitch;
+
+  workers->run([this](int band) { scaleBand(band); });
+}
+
+void Scaler::scaleBand(int band)
+{
+  int bands = workers->getBands();
+  int from = band * height / bands;
+  int to = (band + 1) * height / bands;
+
+  if (pixelSize == 2)
+  {
+    scaleRows((const unsigned short*)source, width, height, from, to, filter, filterScale, factor,
+      (unsigned short*)rowBuffers[band].data(), output, pitch);
+  }
+  else
+  {
+    scaleRows((const unsigned int*)source, width, height, from, to, filter, filterScale, factor,
+      (unsigned int*)rowBuffers[band].data(), output, pitch);
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef _SCALER_H_
+#define _SCALER_H_
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "band_workers.h"
+
+enum ScaleFilter { Nearest, Scale2x, Scale3x, Scale2xSmooth };
+
+// Scales converted frames (16 or 32 bit pixels) with a pixel art filter,
+// followed by nearest neighbor scaling by an integer factor. The frame is
+// split into row bands, one per band worker.
+class Scaler
+{
+public:
+  Scaler(int pixelSize, int width, int height, enum ScaleFilter filter, int factor, boost::shared_ptr<BandWorkers> workers);
+  int getWidth() { return width * filterScale * factor; };
+  int getHeight() { return height * filterScale * factor; };
+  static int getFilterScale(enum ScaleFilter filter);
+
+  // Source rows are packed, output rows are `pitch` bytes apart
+  void scale(const unsigned char *source, unsigned char *output, int pitch);
+
+private:
+  int pixelSize;
+  int width;
+  int height;
+  enum ScaleFilter filter;
+  int filterScale;
+  int factor;
+  const unsigned char *source;
+  unsigned char *output;
+  int pitch;
+  std::vector<std::vector<unsigned char> > rowBuffers;  // Filtered rows of each band
+  boost::shared_ptr<BandWorkers> workers;
+
+  void scaleBand(int band);
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler()
+:
+  cycles(0),
+  nextCycle(SCHEDULER_NEVER)
+{
+  for (int i = 0; i < SchedulerEventCount; i++)
+  {
+    eventCycles[i] = SCHEDULER_NEVER;
+  }
+}
+
+void Scheduler::setHandler(const enum SchedulerEvent &event, std::function<void()> handler)
+{
+  handlers[event] = handler;
+}
+
+void Scheduler::schedule(const enum SchedulerEvent &event, unsigned long long cycle)
+{
+  eventCycles[event] = cycle;
+  updateNextCycle();
+}
+
+void Scheduler::cancel(const enum SchedulerEvent &event)
+{
+  eventCycles[event] = SCHEDULER_NEVER;
+  updateNextCycle();
+}
+
+void Scheduler::dispatch()
+{
+  for (int i = 0; i < SchedulerEventCount; i++)
+  {
+    // Events are one-shot, the handler reschedules if it needs to
+    if (eventCycles[i] <= cycles)
+    {
+      eventCycles[i] = SCHEDULER_NEVER;
+
+      if (handlers[i])
+      {
+        handlers[i]();
+      }
+    }
+  }
+
+  updateNextCycle();
+}
+
+void Scheduler::updateNextCycle()
+{
+  nextCycle = SCHEDULER_NEVER;
+
+  for (int i = 0; i < SchedulerEventCount; i++)
+  {
+    if (eventCycles[i] < nextCycle)
+    {
+      nextCycle = eventCycles[i];
+    }
+  }
+}
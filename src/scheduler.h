@@ -0,0 +1,43 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <functional>
+
+#define SCHEDULER_NEVER  0xFFFFFFFFFFFFFFFFULL
+
+enum SchedulerEvent { MapperIrq, PpuCatchUp, SchedulerEventCount };
+
+// Central timing for events that can be predicted ahead of time. Keeps the
+// number of CPU cycles since power on and calls an event's handler once the
+// cycle it was scheduled for has been reached.
+class Scheduler
+{
+public:
+  Scheduler();
+  unsigned long long getCycles() { return cycles; };
+  unsigned long long getNextCycle() { return nextCycle; };
+  void setHandler(const enum SchedulerEvent &event, std::function<void()> handler);
+  void schedule(const enum SchedulerEvent &event, unsigned long long cycle);
+  void cancel(const enum SchedulerEvent &event);
+
+  void advance(unsigned short elapsed)
+  {
+    cycles += elapsed;
+
+    if (cycles >= nextCycle)
+    {
+      dispatch();
+    }
+  };
+
+private:
+  unsigned long long cycles;
+  unsigned long long nextCycle;
+  unsigned long long eventCycles[SchedulerEventCount];
+  std::function<void()> handlers[SchedulerEventCount];
+
+  void dispatch();
+  void updateNextCycle();
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef _SPSC_QUEUE_H_
+#define _SPSC_QUEUE_H_
+
+#include <atomic>
+
+#define CACHE_LINE_SIZE  64
+
+// Bounded queue between exactly one producer and one consumer thread. Holds
+// up to Size - 1 items, push() and pop() never block.
+template <typename T, unsigned int Size>
+class SpscQueue
+{
+public:
+  SpscQueue() : head(0), tail(0) {};
+
+  bool push(const T &item)
+  {
+    unsigned int current = head.load(std::memory_order_relaxed);
+    unsigned int next = (current + 1) % Size;
+
+    if (next == tail.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    items[current] = item;
+    head.store(next, std::memory_order_release);
+    return true;
+  };
+
+  bool pop(T &item)
+  {
+    unsigned int current = tail.load(std::memory_order_relaxed);
+
+    if (current == head.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    item = items[current];
+    tail.store((current + 1) % Size, std::memory_order_release);
+    return true;
+  };
+
+  bool isEmpty()
+  {
+    return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+  };
+
+private:
+  T items[Size];
+  alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> head;  // Written by the producer
+  alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> tail;  // Written by the consumer
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string.h>
+#include <errno.h>
+
+#include "state_log.h"
+#include "yane_exception.h"
+#include "utils.h"
+
+#define STATE_LOG_HEADER  "# yane state log: frame state cpu ram prgram ppu vram oam palette mapper"
+#define STATE_DUMP_WIDTH  32  // Bytes per line of a dump
+
+StateLog::StateLog(std::string filename, enum StateLogMode mode)
+:
+  filename(filename),
+  mode(mode),
+  matchedFrames(0),
+  isDiverged(false)
+{
+  if (mode == StateLogMode::WriteHashes)
+  {
+    output.open(filename.c_str(), std::ios::out | std::ios::trunc);
+  }
+  else
+  {
+    input.open(filename.c_str(), std::ios::in);
+  }
+
+  if (!output.is_open() && !input.is_open())
+  {
+    throw StateLogException(filename, strerror(errno));
+  }
+
+  if (mode == StateLogMode::WriteHashes)
+  {
+    output << STATE_LOG_HEADER << std::endl;
+  }
+}
+
+bool StateLog::update(unsigned long long frame, const machine_state &state)
+{
+  for (int i = 0; i < StateComponentCount; i++)
+  {
+    hashes[i + 1] = utils::hash64(state.components[i].data(), state.components[i].size());
+  }
+
+  hashes[0] = utils::hash64((const unsigned char*)(hashes + 1), sizeof(unsigned long long) * StateComponentCount);
+
+  if (mode == StateLogMode::WriteHashes)
+  {
+    output << std::dec << frame << std::hex << std::setfill('0');
+
+    for (int i = 0; i <= StateComponentCount; i++)
+    {
+      output << " " << std::setw(16) << hashes[i];
+    }
+
+    output << "\n";
+    return true;
+  }
+
+  if (!readExpected(frame))
+  {
+    return false;
+  }
+
+  if (memcmp(hashes, expected, sizeof(hashes)) == 0)
+  {
+    matchedFrames++;
+    return true;
+  }
+
+  isDiverged = true;
+  std::cout << "State diverged from " << filename << " at frame " << frame << ":" << std::endl;
+  std::cout << std::hex << std::setfill('0');
+
+  for (int i = 0; i < StateComponentCount; i++)
+  {
+    std::cout << (hashes[i + 1] != expected[i + 1] ? "  * " : "    ") << std::left << std::setw(8) << std::setfill(' ') << stateComponentNames[i]
+      << std::right << std::setfill('0') << " expected " << std::setw(16) << expected[i + 1] << ", got " << std::setw(16) << hashes[i + 1] << std::endl;
+  }
+
+  std::cout << std::dec;
+  return false;
+}
+
+// Reads the log line of `frame`, which has to be the next one
+bool StateLog::readExpected(unsigned long long frame)
+{
+  std::string line;
+
+  do
+  {
+    if (!std::getline(input, line))
+    {
+      std::cout << "State log " << filename << " ended after frame " << frame - 1 << ", " << matchedFrames << " frames matched" << std::endl;
+      return false;
+    }
+  } while (line.empty() || line[0] == '#');
+
+  std::istringstream fields(line);
+  unsigned long long logFrame;
+  fields >> std::dec >> logFrame >> std::hex;
+
+  for (int i = 0; i <= StateComponentCount; i++)
+  {
+    fields >> expected[i];
+  }
+
+  if (fields.fail() || logFrame != frame)
+  {
+    throw StateLogException(filename, "No valid entry for frame " + boost::lexical_cast<std::string>(frame));
+  }
+
+  return true;
+}
+
+// Hex dump of every component, two dumps can be compared with diff
+void StateLog::dump(std::string filename, unsigned long long frame, const machine_state &state)
+{
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+  file << "frame " << frame << std::endl << std::hex << std::setfill('0');
+
+  for (int i = 0; i < StateComponentCount; i++)
+  {
+    const std::vector<unsigned char> &data = state.components[i];
+    file << std::endl << stateComponentNames[i] << std::endl;
+
+    for (size_t offset = 0; offset < data.size(); offset += STATE_DUMP_WIDTH)
+    {
+      file << std::setw(4) << offset << ":";
+
+      for (size_t j = offset; j < data.size() && j < offset + STATE_DUMP_WIDTH; j++)
+      {
+        file << " " << std::setw(2) << (int)data[j];
+      }
+
+      file << std::endl;
+    }
+  }
+
+  if (file.good())
+  {
+    std::cout << "State of frame " << frame << " dumped to " << filename << std::endl;
+  }
+  else
+  {
+    std::cerr << "Error: Unable to write state dump " << filename << std::endl;
+  }
+}
@@ -0,0 +1,38 @@
+#ifndef _STATE_LOG_H_
+#define _STATE_LOG_H_
+
+#include <string>
+#include <fstream>
+#include "machine_state.h"
+
+enum StateLogMode { WriteHashes, CompareHashes };
+
+// One line per frame: the frame number, a hash over the whole state and a
+// hash per state component, all in hex. Comparing against a log written by
+// another build finds the first frame where the two runs differ.
+class StateLog
+{
+public:
+  StateLog(std::string filename, enum StateLogMode mode);
+
+  // Returns false when comparing and the frame differs from the log, or the
+  // log has ended
+  bool update(unsigned long long frame, const machine_state &state);
+  static void dump(std::string filename, unsigned long long frame, const machine_state &state);
+  unsigned long long getMatchedFrames() { return matchedFrames; };
+  bool hasDiverged() { return isDiverged; };
+
+private:
+  std::string filename;
+  enum StateLogMode mode;
+  std::ofstream output;
+  std::ifstream input;
+  unsigned long long matchedFrames;
+  bool isDiverged;
+  unsigned long long hashes[StateComponentCount + 1];  // Whole state first
+  unsigned long long expected[StateComponentCount + 1];
+
+  bool readExpected(unsigned long long frame);
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <string.h>
+#include <errno.h>
+
+#include "stats.h"
+#include "yane_exception.h"
+
+namespace stats
+{
+  frame_stats current = frame_stats();
+
+  frame_stats endFrame(unsigned long long frame)
+  {
+    frame_stats snapshot = current;
+    snapshot.frame = frame;
+    snapshot.frames = 1;
+    current = frame_stats();
+    return snapshot;
+  }
+
+  void add(frame_stats &sum, const frame_stats &frame)
+  {
+    sum.frame = frame.frame;
+    sum.frames += frame.frames;
+    sum.instructions += frame.instructions;
+    sum.cycles += frame.cycles;
+
+    for (int i = 0; i < STATS_INTERRUPT_TYPES; i++)
+    {
+      sum.interrupts[i] += frame.interrupts[i];
+    }
+
+    for (int i = 0; i < STATS_PPU_REGISTERS; i++)
+    {
+      sum.ppuReads[i] += frame.ppuReads[i];
+      sum.ppuWrites[i] += frame.ppuWrites[i];
+    }
+
+    sum.vramReads += frame.vramReads;
+    sum.vramWrites += frame.vramWrites;
+    sum.oamWrites += frame.oamWrites;
+    sum.dmaTransfers += frame.dmaTransfers;
+    sum.pollCycles += frame.pollCycles;
+    sum.mapperWrites += frame.mapperWrites;
+    sum.prgSwitches += frame.prgSwitches;
+    sum.chrSwitches += frame.chrSwitches;
+    sum.renderedScanlines += frame.renderedScanlines;
+    sum.skippedScanlines += frame.skippedScanlines;
+  }
+}
+
+StatsDump::StatsDump(std::string filename, unsigned int interval)
+:
+  filename(filename),
+  output(&std::cerr),
+  interval(interval ? interval : 1),
+  sum(frame_stats())
+{
+  if (filename != "-")
+  {
+    file.open(filename.c_str(), std::ios::out | std::ios::trunc);
+
+    if (!file.is_open())
+    {
+      throw StatsException(filename, strerror(errno));
+    }
+
+    output = &file;
+  }
+
+  *output << "frame\tframes\tinstructions\tcycles\tnmi\tirq\tbrk\treset";
+
+  for (int i = 0; i < STATS_PPU_REGISTERS; i++)
+  {
+    *output << "\tread_200" << i;
+  }
+
+  for (int i = 0; i < STATS_PPU_REGISTERS; i++)
+  {
+    *output << "\twrite_200" << i;
+  }
+
+  *output << "\tvram_reads\tvram_writes\toam_writes\tdma\tpoll_cycles\tmapper_writes\tprg_switches\tchr_switches"
+    << "\trendered_lines\tskipped_lines" << std::endl;
+}
+
+void StatsDump::update(const frame_stats &frame)
+{
+  stats::add(sum, frame);
+
+  if (sum.frames < interval)
+  {
+    return;
+  }
+
+  *output << sum.frame << "\t" << sum.frames << "\t" << sum.instructions << "\t" << sum.cycles;
+
+  for (int i = 0; i < STATS_INTERRUPT_TYPES; i++)
+  {
+    *output << "\t" << sum.interrupts[i];
+  }
+
+  for (int i = 0; i < STATS_PPU_REGISTERS; i++)
+  {
+    *output << "\t" << sum.ppuReads[i];
+  }
+
+  for (int i = 0; i < STATS_PPU_REGISTERS; i++)
+  {
+    *output << "\t" << sum.ppuWrites[i];
+  }
+
+  *output << "\t" << sum.vramReads << "\t" << sum.vramWrites << "\t" << sum.oamWrites << "\t" << sum.dmaTransfers
+    << "\t" << sum.pollCycles << "\t" << sum.mapperWrites << "\t" << sum.prgSwitches << "\t" << sum.chrSwitches
+    << "\t" << sum.renderedScanlines << "\t" << sum.skippedScanlines << std::endl;
+
+  sum = frame_stats();
+}
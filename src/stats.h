@@ -0,0 +1,67 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <string>
+#include <fstream>
+
+#define STATS_INTERRUPT_TYPES 4  // Nmi, Irq, Brk, Reset, as in enum Interrupt
+#define STATS_PPU_REGISTERS   8  // $2000-$2007
+
+// Counters of the hot paths are only compiled in with -DYANE_STATS=ON, the
+// macros are empty otherwise
+#ifdef YANE_STATS
+#define STATS_INC(counter)    (stats::current.counter++)
+#define STATS_ADD(counter, n) (stats::current.counter += (n))
+#else
+#define STATS_INC(counter)    ((void)0)
+#define STATS_ADD(counter, n) ((void)0)
+#endif
+
+// What the emulator did during one frame, or summed over several
+typedef struct
+{
+  unsigned long long frame;  // Last frame counted
+  unsigned long long frames;
+  unsigned long long instructions;
+  unsigned long long cycles;  // CPU cycles, with DMA and skipped polling
+  unsigned long long interrupts[STATS_INTERRUPT_TYPES];
+  unsigned long long ppuReads[STATS_PPU_REGISTERS];
+  unsigned long long ppuWrites[STATS_PPU_REGISTERS];
+  unsigned long long vramReads;  // Bytes through $2007
+  unsigned long long vramWrites;
+  unsigned long long oamWrites;  // Bytes through $2004 and DMA
+  unsigned long long dmaTransfers;
+  unsigned long long pollCycles;  // Skipped while the CPU polled $2002
+  unsigned long long mapperWrites;  // CPU writes to $8000-$FFFF
+  unsigned long long prgSwitches;  // 8 Kb PRG pages mapped to another bank
+  unsigned long long chrSwitches;  // 1 Kb CHR pages
+  unsigned long long renderedScanlines;  // Logged for drawing
+  unsigned long long skippedScanlines;  // Visible lines of frames not drawn
+} frame_stats;
+
+namespace stats
+{
+  extern frame_stats current;
+
+  // Returns the counters of the finished frame and starts over
+  frame_stats endFrame(unsigned long long frame);
+  void add(frame_stats &sum, const frame_stats &frame);
+}
+
+// Writes the counters summed over every N frames as tab separated lines,
+// after a header line. "-" writes to stderr.
+class StatsDump
+{
+public:
+  StatsDump(std::string filename, unsigned int interval);
+  void update(const frame_stats &frame);
+
+private:
+  std::string filename;
+  std::ofstream file;
+  std::ostream *output;
+  unsigned int interval;
+  frame_stats sum;
+};
+
+#endif
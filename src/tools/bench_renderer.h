@@ -0,0 +1,35 @@
+#ifndef _BENCH_RENDERER_H_
+#define _BENCH_RENDERER_H_
+
+#include <vector>
+#include <boost/make_shared.hpp>
+#include "renderer.h"
+#include "frame_converter.h"
+
+using namespace std;
+
+// Presents frames by converting them to XRGB8888 in memory, the work the
+// SDL renderer does before a flip. It is not headless, so the PPU draws
+// every frame and can use its render worker, but it isn't paced to 60 Hz.
+class BenchRenderer : public Renderer
+{
+public:
+  BenchRenderer() {};
+
+  void init()
+  {
+    overscan_crop crop = { 0, 0, 0, 0 };
+    converter = boost::make_shared<FrameConverter>(colors, PixelFormat::XRGB8888, crop);
+    screen.resize(converter->getFrameSize());
+  };
+
+  void cleanup() {};
+  void update(const unsigned short *frame) { converter->convert(frame, screen.data()); };
+  bool isPaced() { return false; };
+
+private:
+  boost::shared_ptr<FrameConverter> converter;
+  std::vector<unsigned char> screen;
+};
+
+#endif
@@ -0,0 +1,622 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <boost/make_shared.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "tools/benchmark.h"
+#include "tools/bench_renderer.h"
+#include "yane.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "cartridge.h"
+#include "ines.h"
+#include "opcodes.h"
+#include "rom_assembler.h"
+#include "frame_converter.h"
+#include "scaler.h"
+#include "ntsc_filter.h"
+#include "band_workers.h"
+#include "config.h"
+#include "yane_exception.h"
+
+#define BENCH_OPCODES         1000000
+#define BENCH_ACCESSES        1000000
+#define BENCH_SCANLINE_FRAMES 20  // Drawing the logged frame over again
+#define BENCH_FRAMES_HEADLESS 600
+#define BENCH_FRAMES_DRAWN    300  // Also presented ones
+#define BENCH_WARMUP_FRAMES   60
+#define BENCH_CONVERT_FRAMES  100
+#define BENCH_NTSC_FRAMES     20
+#define BENCH_SCALE_WIDTH     3840  // Fullscreen on a 4K display
+#define BENCH_SCALE_HEIGHT    2160
+#define BENCH_SCALE_FRAMES    10
+#define BENCH_SCALE_MAX_BANDS 4  // The most threads the renderer picks by itself
+
+#define BENCH_PROGRAM_ADDR    0x0300  // RAM the opcode loops run from
+#define BENCH_PROGRAM_OPCODES 64
+#define BENCH_DATA_ADDR       0x0400
+#define BENCH_ZERO_PAGE       0x10
+#define BENCH_POINTER         0x20  // Points to BENCH_DATA_ADDR
+
+// Keeps the compiler from dropping the values read in the benchmarks
+static volatile unsigned int benchSink;
+
+static double now()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+Benchmark::Benchmark()
+{
+  char path[] = "/tmp/yane-bench-XXXXXX";
+
+  if (!mkdtemp(path))
+  {
+    throw BenchmarkException(path, strerror(errno));
+  }
+
+  directory = path;
+
+  for (int i = 0; i < RomWorkloadCount; i++)
+  {
+    romgen::writeRom(romPath((enum RomWorkload)i), (enum RomWorkload)i);
+  }
+
+  // Nothing is shown and no other output is written
+  Config &config = Config::instance();
+  config.renderer = "null";
+  config.renderThread = false;
+  config.doInstructionLogging = false;
+  config.captureVideo = "";
+  config.stateLog = "";
+  config.stateCompare = "";
+  config.stateDumpFrame = 0;
+  config.recordMovie = "";
+  config.playMovie = "";
+}
+
+Benchmark::~Benchmark()
+{
+  for (int i = 0; i < RomWorkloadCount; i++)
+  {
+    unlink(romPath((enum RomWorkload)i).c_str());
+  }
+
+  rmdir(directory.c_str());
+}
+
+std::string Benchmark::romPath(enum RomWorkload workload)
+{
+  return directory + "/" + romWorkloadNames[workload] + ".nes";
+}
+
+void Benchmark::add(std::string name, std::string unit, double value)
+{
+  bench_result result = { name, unit, value };
+  results.push_back(result);
+  std::cout << "  " << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(2) << std::setw(12) << value << " " << unit << std::endl;
+}
+
+// Nanoseconds per operation of the fastest of BENCH_REPEATS batches
+double Benchmark::measure(unsigned long long operations, std::function<void()> batch)
+{
+  double best = 0;
+
+  for (int i = 0; i < BENCH_REPEATS; i++)
+  {
+    double start = now();
+    batch();
+    double elapsed = now() - start;
+
+    if (i == 0 || elapsed < best)
+    {
+      best = elapsed;
+    }
+  }
+
+  return best * 1e9 / operations;
+}
+
+void Benchmark::runFrames(Yane &yane, unsigned long long frames)
+{
+  // Yane reports its shutdown on stdout
+  std::ofstream null("/dev/null");
+  std::streambuf *output = std::cout.rdbuf(null.rdbuf());
+  Config::instance().frameLimit = frames;
+  yane.run();
+  std::cout.rdbuf(output);
+}
+
+void Benchmark::run()
+{
+  std::cout << "Benchmark, best of " << BENCH_REPEATS << " (frames: " << BENCH_FRAME_REPEATS << ") runs:" << std::endl;
+  benchOpcodes();
+  benchMemory();
+  benchScanlines();
+  benchMappers();
+  benchConverter();
+  benchNtsc();
+  benchScaler();
+  benchFrames();
+}
+
+// 64 copies of one instruction and a jump back, run from RAM
+void Benchmark::benchOpcodes()
+{
+  typedef struct
+  {
+    const char *name;
+    unsigned char opcode;
+    int operandBytes;
+    unsigned short operand;
+  } bench_opcode;
+
+  static const bench_opcode opcodes[] =
+  {
+    { "implied", INX, 0, 0 },
+    { "immediate", ADC_IMM, 1, 0x01 },
+    { "zero-page", ADC_ZERO, 1, BENCH_ZERO_PAGE },
+    { "zero-page-x", ADC_ZERO_X, 1, BENCH_ZERO_PAGE },
+    { "absolute", ADC_ABS, 2, BENCH_DATA_ADDR },
+    { "absolute-x", ADC_ABS_X, 2, BENCH_DATA_ADDR },
+    { "absolute-y", ADC_ABS_Y, 2, BENCH_DATA_ADDR },
+    { "indirect-x", ADC_IND_X, 1, BENCH_POINTER },
+    { "indirect-y", ADC_IND_Y, 1, BENCH_POINTER },
+    { "relative", BCC, 1, 0 },  // Taken, to the next instruction
+    { "rmw-zero-page", INC_ZERO, 1, BENCH_ZERO_PAGE },
+    { "rmw-absolute", ASL_ABS, 2, BENCH_DATA_ADDR },
+  };
+
+  Yane yane;
+  yane.init(romPath(RomWorkload::AluLoop));
+  cpu &c = *yane._cpu;
+  c.start();
+  c.write(BENCH_POINTER, BENCH_DATA_ADDR & 0xFF);
+  c.write(BENCH_POINTER + 1, BENCH_DATA_ADDR >> 8);
+
+  for (size_t i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++)
+  {
+    RomAssembler program(BENCH_PROGRAM_ADDR, BENCH_PROGRAM_OPCODES * 3 + 3);
+    program.label("loop");
+
+    for (int j = 0; j < BENCH_PROGRAM_OPCODES; j++)
+    {
+      if (opcodes[i].operandBytes == 2)
+      {
+        program.emitAbs(opcodes[i].opcode, opcodes[i].operand);
+      }
+      else if (opcodes[i].operandBytes == 1)
+      {
+        program.emit(opcodes[i].opcode, opcodes[i].operand);
+      }
+      else
+      {
+        program.emit(opcodes[i].opcode);
+      }
+    }
+
+    program.emitAbs(JMP_ABS, "loop");
+    const std::vector<unsigned char> &image = program.link();
+
+    for (size_t j = 0; j < image.size(); j++)
+    {
+      c.write(BENCH_PROGRAM_ADDR + j, image[j]);
+    }
+
+    c.reg_pc = BENCH_PROGRAM_ADDR;
+    c.reg_status = STATUS_INIT;
+    c.reg_index_x = 0;
+    c.reg_index_y = 0;
+
+    add(std::string("cpu.opcode.") + opcodes[i].name, "ns", measure(BENCH_OPCODES, [&c]()
+    {
+      unsigned int cycles = 0;
+
+      for (int n = 0; n < BENCH_OPCODES; n++)
+      {
+        cycles += c.executeOpcode();
+      }
+
+      benchSink = cycles;
+    }));
+  }
+}
+
+void Benchmark::benchMemory()
+{
+  typedef struct
+  {
+    const char *name;
+    unsigned short base;
+    unsigned short mask;  // Addresses go over base | (i & mask)
+  } bench_region;
+
+  static const bench_region reads[] =
+  {
+    { "ram", 0x0000, 0x07FF },
+    { "ram-mirror", 0x0800, 0x0FFF },
+    { "ppu-status", ADDR_PPU_STATUS, 0x0000 },
+    { "controller", ADDR_INPUT_PORT_1, 0x0000 },
+    { "prg-ram", ADDR_PRG_RAM, 0x1FFF },
+    { "prg-rom", 0x8000, 0x7FFF },
+  };
+
+  static const bench_region writes[] =
+  {
+    { "ram", 0x0000, 0x07FF },
+    { "ppu-scroll", ADDR_PPU_SCROLL, 0x0000 },
+    { "controller", ADDR_INPUT_PORT_1, 0x0000 },
+    { "prg-ram", ADDR_PRG_RAM, 0x1FFF },
+  };
+
+  Yane yane;
+  yane.init(romPath(RomWorkload::AluLoop));
+  cpu &c = *yane._cpu;
+  c.start();
+
+  for (size_t i = 0; i < sizeof(reads) / sizeof(reads[0]); i++)
+  {
+    const bench_region &region = reads[i];
+
+    add(std::string("cpu.read.") + region.name, "ns", measure(BENCH_ACCESSES, [&c, &region]()
+    {
+      unsigned int sum = 0;
+
+      for (int n = 0; n < BENCH_ACCESSES; n++)
+      {
+        sum += c.read(region.base | (n & region.mask));
+      }
+
+      benchSink = sum;
+    }));
+  }
+
+  for (size_t i = 0; i < sizeof(writes) / sizeof(writes[0]); i++)
+  {
+    const bench_region &region = writes[i];
+
+    add(std::string("cpu.write.") + region.name, "ns", measure(BENCH_ACCESSES, [&c, &region]()
+    {
+      for (int n = 0; n < BENCH_ACCESSES; n++)
+      {
+        c.write(region.base | (n & region.mask), n & 0x01);
+      }
+    }));
+  }
+}
+
+// Draws the scanlines of a logged frame again and again, after the rom had
+// some frames to set up its scene
+void Benchmark::benchScanlines()
+{
+  static const enum RomWorkload workloads[] = { RomWorkload::ScrollSplits, RomWorkload::Sprites8x16, RomWorkload::Mmc3StatusBar };
+
+  for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+  {
+    std::string name = romWorkloadNames[workloads[i]];
+    Yane yane;
+    yane.init(romPath(workloads[i]));
+    yane._ppu->requestFrame(BENCH_WARMUP_FRAMES);
+    runFrames(yane, BENCH_WARMUP_FRAMES);
+
+    // Only the line count was reset for the next frame
+    ppu &p = *yane._ppu;
+    boost::shared_ptr<frame_log> log = boost::make_shared<frame_log>(*p.frameLog);
+    log->lineCount = SCREEN_HEIGHT;
+    const unsigned long long lines = SCREEN_HEIGHT * BENCH_SCANLINE_FRAMES;
+
+    add("ppu.background." + name, "ns", measure(lines, [&p, &log]()
+    {
+      unsigned char pixels[SCREEN_WIDTH];
+      unsigned long long opaque[OPAQUE_MASK_WORDS];
+
+      for (int frame = 0; frame < BENCH_SCANLINE_FRAMES; frame++)
+      {
+        for (int y = 0; y < SCREEN_HEIGHT; y++)
+        {
+          p.renderBackground(log->lines[y], log->nameTables, log->attributes, pixels, opaque);
+        }
+      }
+
+      benchSink = pixels[0] + (unsigned int)opaque[0];
+    }));
+
+    add("ppu.sprites." + name, "ns", measure(lines, [&p, &log]()
+    {
+      unsigned char pixels[SCREEN_WIDTH];
+
+      for (int frame = 0; frame < BENCH_SCANLINE_FRAMES; frame++)
+      {
+        for (int y = 0; y < SCREEN_HEIGHT; y++)
+        {
+          memset(pixels, 0, sizeof(pixels));
+          p.renderSprites(*log, log->lines[y], y, pixels);
+        }
+      }
+
+      benchSink = pixels[0];
+    }));
+
+    add("ppu.scanline." + name, "ns", measure(lines, [&p, &log]()
+    {
+      for (int frame = 0; frame < BENCH_SCANLINE_FRAMES; frame++)
+      {
+        for (int y = 0; y < SCREEN_HEIGHT; y++)
+        {
+          p.drawScanline(*log, y);
+        }
+      }
+
+      benchSink = p.frameBuffer[0];
+    }));
+  }
+}
+
+// Reads through the banks the rom has mapped after its warm up frames
+void Benchmark::benchMappers()
+{
+  static const enum RomWorkload workloads[] = { RomWorkload::AluLoop, RomWorkload::BankSwitching, RomWorkload::Mmc3StatusBar };
+
+  for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+  {
+    Yane yane;
+    yane.init(romPath(workloads[i]));
+    runFrames(yane, BENCH_WARMUP_FRAMES);
+
+    Cartridge &mapper = *yane._mapper;
+    std::string name = "mapper" + boost::lexical_cast<std::string>(yane._rom->getMapperId());
+
+    add(name + ".read-prg", "ns", measure(BENCH_ACCESSES, [&mapper]()
+    {
+      unsigned int sum = 0;
+      unsigned char value = 0;
+
+      for (int n = 0; n < BENCH_ACCESSES; n++)
+      {
+        mapper.readPrgRom(0x8000 | (n & 0x7FFF), value);
+        sum += value;
+      }
+
+      benchSink = sum;
+    }));
+
+    add(name + ".read-chr", "ns", measure(BENCH_ACCESSES, [&mapper]()
+    {
+      unsigned int sum = 0;
+      unsigned char value = 0;
+
+      for (int n = 0; n < BENCH_ACCESSES; n++)
+      {
+        mapper.readChrRom(n & 0x1FFF, value);
+        sum += value;
+      }
+
+      benchSink = sum;
+    }));
+  }
+}
+
+// A frame of the scroll rom after the warm up, and the colors of its indices
+void Benchmark::drawFrame(std::vector<unsigned short> &frame, std::vector<palette_entry> &colors)
+{
+  Yane yane;
+  yane.init(romPath(RomWorkload::ScrollSplits));
+  yane._ppu->requestFrame(BENCH_WARMUP_FRAMES);
+  runFrames(yane, BENCH_WARMUP_FRAMES);
+
+  frame.assign(yane._ppu->getFrameBuffer(), yane._ppu->getFrameBuffer() + SCREEN_WIDTH * SCREEN_HEIGHT);
+  colors.assign(yane._ppu->getColorTable(), yane._ppu->getColorTable() + PALETTE_TABLE_SIZE);
+}
+
+// Converts a drawn frame with the default overscan crop to every pixel
+// format. The AVX2 kernels of the RGB formats are timed against the scalar
+// loops, and must give the same bytes.
+void Benchmark::benchConverter()
+{
+  static const enum PixelFormat formats[] = { PixelFormat::RGB565, PixelFormat::XRGB8888, PixelFormat::YUV420 };
+  static const char * const formatNames[] = { "rgb565", "xrgb8888", "yuv420" };
+
+  std::vector<unsigned short> frame;
+  std::vector<palette_entry> colors;
+  drawFrame(frame, colors);
+
+  Config &config = Config::instance();
+  overscan_crop crop = { config.overscanTop, config.overscanBottom, config.overscanLeft, config.overscanRight };
+
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+  {
+    FrameConverter converter(colors.data(), formats[i], crop);
+    std::vector<unsigned char> output(converter.getFrameSize());
+    std::vector<unsigned char> scalarOutput(converter.getFrameSize());
+    std::string name = std::string("convert.") + formatNames[i];
+    bool isVectorized = converter.isVectorized();
+
+    add(name, "ns", measure(BENCH_CONVERT_FRAMES, [&converter, &frame, &output]()
+    {
+      for (int n = 0; n < BENCH_CONVERT_FRAMES; n++)
+      {
+        converter.convert(frame.data(), output.data());
+      }
+
+      benchSink = output[0];
+    }));
+
+    if (!isVectorized)
+    {
+      continue;
+    }
+
+    converter.setVectorized(false);
+
+    add(name + ".scalar", "ns", measure(BENCH_CONVERT_FRAMES, [&converter, &frame, &scalarOutput]()
+    {
+      for (int n = 0; n < BENCH_CONVERT_FRAMES; n++)
+      {
+        converter.convert(frame.data(), scalarOutput.data());
+      }
+
+      benchSink = scalarOutput[0];
+    }));
+
+    if (output != scalarOutput)
+    {
+      throw BenchmarkException(name, "The AVX2 kernel differs from the scalar loop");
+    }
+  }
+}
+
+// Runs a drawn frame through the NTSC filter on one thread, with the
+// default overscan crop, to the RGB formats it supports
+void Benchmark::benchNtsc()
+{
+  static const enum PixelFormat formats[] = { PixelFormat::RGB565, PixelFormat::XRGB8888 };
+  static const char * const formatNames[] = { "rgb565", "xrgb8888" };
+
+  std::vector<unsigned short> frame;
+  std::vector<palette_entry> colors;
+  drawFrame(frame, colors);
+
+  Config &config = Config::instance();
+  overscan_crop crop = { config.overscanTop, config.overscanBottom, config.overscanLeft, config.overscanRight };
+
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+  {
+    NtscFilter filter(formats[i], crop, 0.0, 1.0, boost::make_shared<BandWorkers>(1));
+    std::vector<unsigned char> output(filter.getFrameSize());
+
+    add(std::string("ntsc.") + formatNames[i], "ns", measure(BENCH_NTSC_FRAMES, [&filter, &frame, &output]()
+    {
+      for (int n = 0; n < BENCH_NTSC_FRAMES; n++)
+      {
+        filter.convert(frame.data(), output.data());
+      }
+
+      benchSink = output[0];
+    }));
+  }
+}
+
+// Scales a drawn frame to a 4K screen with the largest factor that fits,
+// as the SDL renderer does fullscreen, split into 1, 2 and 4 row bands
+void Benchmark::benchScaler()
+{
+  static const enum ScaleFilter filters[] = { ScaleFilter::Nearest, ScaleFilter::Scale2x, ScaleFilter::Scale3x, ScaleFilter::Scale2xSmooth };
+  static const char * const filterNames[] = { "nearest", "scale2x", "scale3x", "scale2x-smooth" };
+
+  std::vector<unsigned short> frameBuffer;
+  std::vector<palette_entry> colors;
+  drawFrame(frameBuffer, colors);
+
+  // 32 bit pixels, as converted for an XRGB8888 screen
+  std::vector<unsigned int> frame(SCREEN_WIDTH * SCREEN_HEIGHT);
+  std::vector<unsigned char> screen(BENCH_SCALE_WIDTH * BENCH_SCALE_HEIGHT * sizeof(unsigned int));
+
+  for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++)
+  {
+    const palette_entry &color = colors[frameBuffer[i]];
+    frame[i] = (color.r << 16) | (color.g << 8) | color.b;
+  }
+
+  for (size_t i = 0; i < sizeof(filters) / sizeof(filters[0]); i++)
+  {
+    int filterScale = Scaler::getFilterScale(filters[i]);
+    int factor = std::min(BENCH_SCALE_WIDTH / (SCREEN_WIDTH * filterScale), BENCH_SCALE_HEIGHT / (SCREEN_HEIGHT * filterScale));
+
+    for (int bands = 1; bands <= BENCH_SCALE_MAX_BANDS; bands *= 2)
+    {
+      Scaler scaler(sizeof(unsigned int), SCREEN_WIDTH, SCREEN_HEIGHT, filters[i], factor, boost::make_shared<BandWorkers>(bands));
+      std::string name = std::string("scale.") + filterNames[i] + ".4k." + boost::lexical_cast<std::string>(bands) + "-threads";
+
+      add(name, "ns", measure(BENCH_SCALE_FRAMES, [&scaler, &frame, &screen]()
+      {
+        for (int n = 0; n < BENCH_SCALE_FRAMES; n++)
+        {
+          scaler.scale((const unsigned char*)frame.data(), screen.data(), BENCH_SCALE_WIDTH * sizeof(unsigned int));
+        }
+
+        benchSink = screen[0];
+      }));
+    }
+  }
+}
+
+// Whole runs through Yane::run() in every FrameMode
+void Benchmark::benchFrames()
+{
+  for (int i = 0; i < RomWorkloadCount; i++)
+  {
+    for (int mode = 0; mode < FrameModeCount; mode++)
+    {
+      unsigned long long frames = (mode == FrameMode::Headless) ? BENCH_FRAMES_HEADLESS : BENCH_FRAMES_DRAWN;
+      double best = 0;
+
+      for (int repeat = 0; repeat < BENCH_FRAME_REPEATS; repeat++)
+      {
+        Yane yane;
+        Config::instance().renderThread = (mode == FrameMode::RenderThread);
+
+        if (mode == FrameMode::Presented || mode == FrameMode::RenderThread)
+        {
+          yane.init(romPath((enum RomWorkload)i), boost::make_shared<BenchRenderer>());
+        }
+        else
+        {
+          yane.init(romPath((enum RomWorkload)i));
+        }
+
+        for (unsigned long long frame = 1; mode == FrameMode::Drawn && frame <= frames; frame++)
+        {
+          yane._ppu->requestFrame(frame);
+        }
+
+        double start = now();
+        runFrames(yane, frames);
+        double elapsed = now() - start;
+
+        if (repeat == 0 || elapsed < best)
+        {
+          best = elapsed;
+        }
+      }
+
+      Config::instance().renderThread = false;
+      add(std::string("frames.") + romWorkloadNames[i] + "." + frameModeNames[mode], "fps", frames / best);
+    }
+  }
+}
+
+void Benchmark::save(std::string filename)
+{
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+  char host[256] = "";
+  gethostname(host, sizeof(host) - 1);
+
+  file << "{" << std::endl;
+  file << "  \"version\": \"" << Config::instance().getVersion() << "\"," << std::endl;
+  file << "  \"host\": \"" << host << "\"," << std::endl;
+  file << "  \"results\": [" << std::endl;
+  file << std::fixed << std::setprecision(3);
+
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    file << "    { \"name\": \"" << results[i].name << "\", \"unit\": \"" << results[i].unit << "\", \"value\": " << results[i].value << " }"
+      << (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+
+  file << "  ]" << std::endl << "}" << std::endl;
+
+  if (!file.good())
+  {
+    throw BenchmarkException(filename, "Unable to write results");
+  }
+
+  std::cout << "Benchmark results saved to " << filename << std::endl;
+}
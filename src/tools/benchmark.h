@@ -0,0 +1,61 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "rom_generator.h"
+#include "ppu.h"
+
+#define BENCH_REPEATS         5  // Microbenchmarks keep the best run
+#define BENCH_FRAME_REPEATS   3
+
+// How whole frames are run: not drawn, drawn but not presented, presented,
+// and presented with the render worker drawing the frames
+enum FrameMode { Headless, Drawn, Presented, RenderThread, FrameModeCount };
+
+static const char * const frameModeNames[FrameModeCount] = { "headless", "drawn", "presented", "render-thread" };
+
+class Yane;
+
+typedef struct
+{
+  std::string name;
+  std::string unit;  // "ns" per operation, lower is better, or "fps"
+  double value;
+} bench_result;
+
+// Times the hot paths of the emulator on the synthetic roms: opcodes per
+// addressing mode, CPU bus reads and writes per region, scanline drawing,
+// mapper reads, pixel format conversion, the NTSC filter, scaling to a 4K
+// screen, and whole frames. Results are saved as JSON, compare them against
+// a baseline taken on the same machine with scripts/bench_compare.py.
+class Benchmark
+{
+public:
+  Benchmark();
+  ~Benchmark();
+  void run();
+  void save(std::string filename);
+
+private:
+  std::string directory;
+  std::vector<bench_result> results;
+
+  std::string romPath(enum RomWorkload workload);
+  void add(std::string name, std::string unit, double value);
+  double measure(unsigned long long operations, std::function<void()> batch);
+  void runFrames(Yane &yane, unsigned long long frames);
+  void drawFrame(std::vector<unsigned short> &frame, std::vector<palette_entry> &colors);
+
+  void benchOpcodes();
+  void benchMemory();
+  void benchScanlines();
+  void benchMappers();
+  void benchConverter();
+  void benchNtsc();
+  void benchScaler();
+  void benchFrames();
+};
+
+#endif
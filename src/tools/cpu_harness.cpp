@@ -0,0 +1,420 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <string.h>
+#include <boost/make_shared.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "tools/cpu_harness.h"
+#include "ines.h"
+#include "config.h"
+#include "yane_exception.h"
+
+// Cores that can be tested, new ones are added here
+const std::map<std::string, cpu_factory> CpuHarness::cores =
+{
+  {HARNESS_REFERENCE_CORE, []() { return boost::make_shared<cpu>(); }},
+};
+
+static std::string hex(unsigned int value, int width)
+{
+  std::ostringstream ss;
+  ss << "$" << std::uppercase << std::hex << std::setw(width) << std::setfill('0') << value;
+  return ss.str();
+}
+
+static void append(std::string &diff, std::string part)
+{
+  if (!part.empty())
+  {
+    diff += (diff.empty() ? "" : ", ") + part;
+  }
+}
+
+static cpu_registers parseRegisters(const boost::property_tree::ptree &state)
+{
+  cpu_registers registers;
+  registers.pc = state.get<unsigned int>("pc");
+  registers.sp = state.get<unsigned int>("s");
+  registers.acc = state.get<unsigned int>("a");
+  registers.x = state.get<unsigned int>("x");
+  registers.y = state.get<unsigned int>("y");
+  registers.status = state.get<unsigned int>("p");
+  return registers;
+}
+
+// Entries of "ram" are [address, value], of "cycles" [address, value, "read" or "write"]
+static bus_access parseAccess(const boost::property_tree::ptree &entry)
+{
+  boost::property_tree::ptree::const_iterator it = entry.begin();
+  bus_access access = { 0, 0, false };
+
+  if (it == entry.end())
+  {
+    throw boost::property_tree::ptree_bad_data("Empty memory entry", entry.data());
+  }
+
+  access.address = it->second.get_value<unsigned int>();
+
+  if (++it == entry.end())
+  {
+    throw boost::property_tree::ptree_bad_data("Memory entry has no value", entry.data());
+  }
+
+  access.value = it->second.get_value<unsigned int>();
+
+  if (++it != entry.end())
+  {
+    access.isWrite = it->second.data() == "write";
+  }
+
+  return access;
+}
+
+CpuHarness::CpuHarness(std::string core)
+:
+  coreName(core)
+{
+  std::map<std::string, cpu_factory>::const_iterator it = cores.find(core);
+
+  if (it == cores.end())
+  {
+    throw CpuHarnessException(core, "Unknown CPU core");
+  }
+
+  factory = it->second;
+
+  // Logging would read the instruction bytes through the bus too
+  Config::instance().doInstructionLogging = false;
+}
+
+boost::shared_ptr<cpu> CpuHarness::create(cpu_factory factory, std::vector<bus_access> &accesses)
+{
+  boost::shared_ptr<cpu> core = factory();
+  core->setFlatBus(&accesses);
+  return core;
+}
+
+cpu_registers CpuHarness::getRegisters(cpu &core)
+{
+  cpu_registers registers = { core.reg_pc, core.reg_sp, core.reg_acc, core.reg_index_x, core.reg_index_y, core.reg_status };
+  return registers;
+}
+
+void CpuHarness::setRegisters(cpu &core, const cpu_registers &registers)
+{
+  core.reg_pc = registers.pc;
+  core.reg_sp = registers.sp;
+  core.reg_acc = registers.acc;
+  core.reg_index_x = registers.x;
+  core.reg_index_y = registers.y;
+  core.reg_status = registers.status;
+  core.interrupts.clear();
+}
+
+unsigned short CpuHarness::step(cpu &core, std::vector<bus_access> &accesses, bool &isInvalid)
+{
+  accesses.clear();
+  isInvalid = false;
+
+  try
+  {
+    return core.executeOpcode();
+  }
+  catch (const InvalidOpcodeException &e)
+  {
+    isInvalid = true;
+  }
+
+  return 0;
+}
+
+// The vectors have the dummy write of read-modify-write instructions, which
+// the cores don't emulate. Collapsing keeps the last of repeated writes.
+std::vector<bus_access> CpuHarness::getWrites(const std::vector<bus_access> &accesses, bool collapseDummyWrites)
+{
+  std::vector<bus_access> writes;
+
+  for (std::vector<bus_access>::const_iterator it = accesses.begin(); it != accesses.end(); ++it)
+  {
+    if (!it->isWrite)
+    {
+      continue;
+    }
+
+    // A dummy write is followed by the real one
+    if (collapseDummyWrites && !writes.empty() && writes.back().address == it->address)
+    {
+      writes.back() = *it;
+    }
+    else
+    {
+      writes.push_back(*it);
+    }
+  }
+
+  return writes;
+}
+
+std::string CpuHarness::formatStatus(unsigned char status)
+{
+  static const char flags[] = "NV-BDIZC";
+  std::string s;
+
+  for (int i = 0; i < 8; i++)
+  {
+    bool isSet = status & (0x80 >> i);
+    s += isSet ? flags[i] : tolower(flags[i]);
+  }
+
+  return s;
+}
+
+std::string CpuHarness::diffRegisters(const cpu_registers &expected, const cpu_registers &actual)
+{
+  std::string diff;
+
+  if (expected.pc != actual.pc)
+  {
+    append(diff, "pc " + hex(expected.pc, 4) + " != " + hex(actual.pc, 4));
+  }
+
+  if (expected.sp != actual.sp)
+  {
+    append(diff, "s " + hex(expected.sp, 2) + " != " + hex(actual.sp, 2));
+  }
+
+  if (expected.acc != actual.acc)
+  {
+    append(diff, "a " + hex(expected.acc, 2) + " != " + hex(actual.acc, 2));
+  }
+
+  if (expected.x != actual.x)
+  {
+    append(diff, "x " + hex(expected.x, 2) + " != " + hex(actual.x, 2));
+  }
+
+  if (expected.y != actual.y)
+  {
+    append(diff, "y " + hex(expected.y, 2) + " != " + hex(actual.y, 2));
+  }
+
+  // The B flag and bit 5 only exist in copies pushed to the stack, which are
+  // compared as writes. The core sets bit 5 at the next opcode fetch.
+  if ((expected.status ^ actual.status) & ~(STATUS_BRK | STATUS_EMPTY))
+  {
+    append(diff, "p " + formatStatus(expected.status) + " != " + formatStatus(actual.status));
+  }
+
+  return diff;
+}
+
+std::string CpuHarness::diffWrites(const std::vector<bus_access> &expected, const std::vector<bus_access> &actual)
+{
+  std::string diff;
+
+  for (size_t i = 0; i < std::max(expected.size(), actual.size()); i++)
+  {
+    std::string want = i < expected.size() ? hex(expected[i].value, 2) + " to " + hex(expected[i].address, 4) : "none";
+    std::string got = i < actual.size() ? hex(actual[i].value, 2) + " to " + hex(actual[i].address, 4) : "none";
+
+    if (want != got)
+    {
+      append(diff, "write " + boost::lexical_cast<std::string>(i + 1) + " " + want + " != " + got);
+      break;
+    }
+  }
+
+  return diff;
+}
+
+int CpuHarness::runVectors(std::vector<std::string> filenames)
+{
+  std::vector<bus_access> accesses;
+  boost::shared_ptr<cpu> core = create(factory, accesses);
+  unsigned char *memory = getMemory(*core);
+  unsigned long long totalPassed = 0, totalFailed = 0, totalSkipped = 0;
+
+  for (std::vector<std::string>::iterator file = filenames.begin(); file != filenames.end(); ++file)
+  {
+    boost::property_tree::ptree tests;
+    unsigned long long passed = 0, failed = 0, skipped = 0;
+
+    try
+    {
+      boost::property_tree::read_json(*file, tests);
+    }
+    catch (const boost::property_tree::ptree_error &e)
+    {
+      throw CpuHarnessException(*file, e.what());
+    }
+
+    for (boost::property_tree::ptree::const_iterator test = tests.begin(); test != tests.end(); ++test)
+    {
+      std::string name, diff;
+      bool isInvalid = false;
+
+      try
+      {
+        name = test->second.get<std::string>("name");
+        const boost::property_tree::ptree &initial = test->second.get_child("initial");
+        const boost::property_tree::ptree &final = test->second.get_child("final");
+        const boost::property_tree::ptree &cycles = test->second.get_child("cycles");
+
+        setRegisters(*core, parseRegisters(initial));
+
+        for (boost::property_tree::ptree::const_iterator it = initial.get_child("ram").begin(); it != initial.get_child("ram").end(); ++it)
+        {
+          bus_access entry = parseAccess(it->second);
+          memory[entry.address] = entry.value;
+        }
+
+        unsigned short cycleCount = step(*core, accesses, isInvalid);
+
+        if (!isInvalid)
+        {
+          std::vector<bus_access> expected;
+          diff = diffRegisters(parseRegisters(final), getRegisters(*core));
+
+          for (boost::property_tree::ptree::const_iterator it = final.get_child("ram").begin(); it != final.get_child("ram").end(); ++it)
+          {
+            bus_access entry = parseAccess(it->second);
+
+            if (memory[entry.address] != entry.value)
+            {
+              append(diff, "ram " + hex(entry.address, 4) + " " + hex(entry.value, 2) + " != " + hex(memory[entry.address], 2));
+            }
+          }
+
+          for (boost::property_tree::ptree::const_iterator it = cycles.begin(); it != cycles.end(); ++it)
+          {
+            expected.push_back(parseAccess(it->second));
+          }
+
+          if (cycleCount != expected.size())
+          {
+            append(diff, "cycles " + boost::lexical_cast<std::string>(expected.size()) + " != " + boost::lexical_cast<std::string>(cycleCount));
+          }
+
+          append(diff, diffWrites(getWrites(expected, true), getWrites(accesses, true)));
+        }
+
+        // Leave a clean memory for the next test
+        for (boost::property_tree::ptree::const_iterator it = initial.get_child("ram").begin(); it != initial.get_child("ram").end(); ++it)
+        {
+          memory[parseAccess(it->second).address] = 0;
+        }
+
+        for (std::vector<bus_access>::iterator it = accesses.begin(); it != accesses.end(); ++it)
+        {
+          memory[it->address] = 0;
+        }
+      }
+      catch (const boost::property_tree::ptree_error &e)
+      {
+        throw CpuHarnessException(*file, "Test " + name + ": " + e.what());
+      }
+
+      if (isInvalid)
+      {
+        skipped++;
+      }
+      else if (diff.empty())
+      {
+        passed++;
+      }
+      else if (++failed <= HARNESS_MAX_REPORTS)
+      {
+        std::cout << "  " << name << ": " << diff << std::endl;
+      }
+    }
+
+    std::cout << *file << ": " << passed << " passed, " << failed << " failed, " << skipped << " skipped" << std::endl;
+    totalPassed += passed;
+    totalFailed += failed;
+    totalSkipped += skipped;
+  }
+
+  std::cout << "CPU vectors on " << coreName << ": " << totalPassed << " passed, " << totalFailed << " failed, "
+    << totalSkipped << " skipped (opcodes the core does not implement)" << std::endl;
+  return totalFailed ? 1 : 0;
+}
+
+int CpuHarness::runLockstep(std::string filename, unsigned long long steps)
+{
+  iNes rom(filename);
+  rom.init();
+
+  if (!rom.isValid() || rom.getPrgRomCount() < PRG_BANKS_FOR_16KB)
+  {
+    throw CpuHarnessException(filename, "Not a valid iNES rom");
+  }
+
+  std::vector<bus_access> referenceAccesses, candidateAccesses;
+  boost::shared_ptr<cpu> reference = create(cores.at(HARNESS_REFERENCE_CORE), referenceAccesses);
+  boost::shared_ptr<cpu> candidate = create(factory, candidateAccesses);
+  cpu *both[] = { reference.get(), candidate.get() };
+
+  // The first 16 KB of PRG-ROM at $8000 and the last at $C000, as mappers
+  // start up. I/O registers are plain memory, both cores see the same.
+  for (int i = 0; i < 2; i++)
+  {
+    unsigned char *memory = getMemory(*both[i]);
+    int lastPages = rom.getPrgRomCount() - PRG_BANKS_FOR_16KB;
+
+    for (int page = 0; page < PRG_BANKS_FOR_16KB; page++)
+    {
+      memcpy(memory + PRG_FIRST_BANK_ADDR + page * PRG_BANK_SIZE, rom.getPrgRomPage(page)->data, PRG_BANK_SIZE);
+      memcpy(memory + PRG_SECOND_BANK_ADDR + page * PRG_BANK_SIZE, rom.getPrgRomPage(lastPages + page)->data, PRG_BANK_SIZE);
+    }
+
+    cpu_registers registers = { 0, SP_INIT, 0, 0, 0, STATUS_INIT };
+    registers.pc = memory[INTERRUPT_RESET_LOW] | (memory[INTERRUPT_RESET_HIGH] << 8);
+    setRegisters(*both[i], registers);
+  }
+
+  for (unsigned long long n = 1; n <= steps; n++)
+  {
+    cpu_registers before = getRegisters(*reference);
+    unsigned char opcode = getMemory(*reference)[before.pc];
+    bool referenceInvalid, candidateInvalid;
+    unsigned short referenceCycles = step(*reference, referenceAccesses, referenceInvalid);
+    unsigned short candidateCycles = step(*candidate, candidateAccesses, candidateInvalid);
+    std::string diff;
+
+    if (referenceInvalid && candidateInvalid)
+    {
+      std::cout << "Both cores stopped at invalid opcode " << hex(opcode, 2) << " at " << hex(before.pc, 4)
+        << " after " << n - 1 << " instructions" << std::endl;
+      return 0;
+    }
+    else if (referenceInvalid != candidateInvalid)
+    {
+      diff = std::string(referenceInvalid ? HARNESS_REFERENCE_CORE : coreName) + " does not implement the opcode";
+    }
+    else
+    {
+      diff = diffRegisters(getRegisters(*reference), getRegisters(*candidate));
+
+      if (referenceCycles != candidateCycles)
+      {
+        append(diff, "cycles " + boost::lexical_cast<std::string>(referenceCycles) + " != " + boost::lexical_cast<std::string>(candidateCycles));
+      }
+
+      append(diff, diffWrites(getWrites(referenceAccesses, false), getWrites(candidateAccesses, false)));
+    }
+
+    if (!diff.empty())
+    {
+      std::cout << "Cores differ at instruction " << n << ", opcode " << hex(opcode, 2) << " at " << hex(before.pc, 4)
+        << " (" << HARNESS_REFERENCE_CORE << " != " << coreName << "): " << diff << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << steps << " instructions of " << filename << " matched between " << HARNESS_REFERENCE_CORE << " and " << coreName << std::endl;
+  return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef _CPU_HARNESS_H_
+#define _CPU_HARNESS_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <boost/shared_ptr.hpp>
+
+#include "cpu.h"
+
+#define HARNESS_REFERENCE_CORE  "interpreter"
+#define HARNESS_MAX_REPORTS     10  // Failed vectors printed per file
+#define HARNESS_DEFAULT_STEPS   1000000
+
+typedef std::function<boost::shared_ptr<cpu>()> cpu_factory;
+
+typedef struct
+{
+  unsigned short pc;
+  unsigned char sp;
+  unsigned char acc;
+  unsigned char x;
+  unsigned char y;
+  unsigned char status;
+} cpu_registers;
+
+// Checks CPU cores instruction by instruction, on a flat 64 KB memory
+// without mapper or PPU. Single step vectors are replayed from JSON files,
+// each an array of tests with the registers and RAM before and after one
+// instruction and the bus cycles in between. A rom can also run on the
+// reference core and another one side by side, compared after every
+// instruction. Dummy writes of read-modify-write instructions are not
+// emulated, so against the vectors repeated writes to one address only
+// count the last. BRK only queues its interrupt, which the interpreter takes
+// as the next step, so BRK vectors fail. Cores in lockstep have to make the
+// very same writes.
+class CpuHarness
+{
+public:
+  CpuHarness(std::string core);
+
+  // Both return the exit code, 0 when nothing differed
+  int runVectors(std::vector<std::string> filenames);
+  int runLockstep(std::string filename, unsigned long long steps);
+
+private:
+  std::string coreName;
+  cpu_factory factory;
+  static const std::map<std::string, cpu_factory> cores;
+
+  boost::shared_ptr<cpu> create(cpu_factory factory, std::vector<bus_access> &accesses);
+  cpu_registers getRegisters(cpu &core);
+  void setRegisters(cpu &core, const cpu_registers &registers);
+  unsigned char *getMemory(cpu &core) { return core.memory; };
+  unsigned short step(cpu &core, std::vector<bus_access> &accesses, bool &isInvalid);
+  std::vector<bus_access> getWrites(const std::vector<bus_access> &accesses, bool collapseDummyWrites);
+
+  std::string diffRegisters(const cpu_registers &expected, const cpu_registers &actual);
+  std::string diffWrites(const std::vector<bus_access> &expected, const std::vector<bus_access> &actual);
+  std::string formatStatus(unsigned char status);
+};
+
+#endif
@@ -0,0 +1,463 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <thread>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <boost/algorithm/string.hpp>
+
+#include "tools/golden_frames.h"
+#include "yane.h"
+#include "config.h"
+#include "yane_exception.h"
+#include "utils.h"
+
+#define GOLDEN_PIXELS  (SCREEN_WIDTH * SCREEN_HEIGHT)
+
+static std::string stem(std::string path)
+{
+  path = path.substr(path.find_last_of('/') + 1);
+  return path.substr(0, path.find_last_of('.'));
+}
+
+static bool writePpm(std::string filename, const std::vector<unsigned char> &pixels)
+{
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  file << "P6\n" << SCREEN_WIDTH << " " << SCREEN_HEIGHT << "\n255\n";
+  file.write((const char*)pixels.data(), pixels.size());
+  return file.good();
+}
+
+// Only reads the images written by writePpm()
+static bool readPpm(std::string filename, std::vector<unsigned char> &pixels)
+{
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  std::string magic;
+  int width = 0, height = 0, depth = 0;
+  file >> magic >> width >> height >> depth;
+  file.get();
+
+  if (!file || magic != "P6" || width != SCREEN_WIDTH || height != SCREEN_HEIGHT || depth != 255)
+  {
+    return false;
+  }
+
+  pixels.resize(GOLDEN_PIXELS * 3);
+  file.read((char*)pixels.data(), pixels.size());
+  return file.good();
+}
+
+GoldenFrames::GoldenFrames(std::string filename, std::string romDirectory, bool isUpdate)
+:
+  filename(filename),
+  isUpdate(isUpdate)
+{
+  size_t slash = filename.find_last_of('/');
+  directory = slash == std::string::npos ? "" : filename.substr(0, slash + 1);
+  this->romDirectory = romDirectory.empty() ? directory : romDirectory + "/";
+  parse();
+}
+
+void GoldenFrames::parse()
+{
+  std::ifstream file(filename.c_str(), std::ios::in);
+
+  if (!file.is_open())
+  {
+    throw GoldenFramesException(filename, strerror(errno));
+  }
+
+  std::string line;
+  std::map<std::pair<std::string, std::string>, size_t> runIndex;
+
+  while (std::getline(file, line))
+  {
+    lines.push_back(line);
+    boost::algorithm::trim(line);
+
+    if (line.empty() || line[0] == '#')
+    {
+      continue;
+    }
+
+    std::istringstream fields(line);
+    golden_case c;
+    c.line = lines.size() - 1;
+    c.frame = 0;
+    c.changedPixels = 0;
+    fields >> c.rom >> c.movie >> c.frame;
+
+    if (fields.fail())
+    {
+      throw GoldenFramesException(filename, "Invalid case on line " + boost::lexical_cast<std::string>(lines.size()));
+    }
+
+    // Frame 1 only has the vblank lines after power on
+    if (c.frame < 2)
+    {
+      throw GoldenFramesException(filename, "Checkpoints start at frame 2, line " + boost::lexical_cast<std::string>(lines.size()));
+    }
+
+    if (!(fields >> c.golden) || c.golden == GOLDEN_NO_HASH)
+    {
+      c.golden = "";
+    }
+
+    std::pair<std::string, std::string> key(c.rom, c.movie);
+
+    if (!runIndex.count(key))
+    {
+      golden_run r;
+      r.rom = resolve(romDirectory, c.rom);
+      r.movie = c.movie == GOLDEN_NO_MOVIE ? "" : resolve(directory, c.movie);
+      r.pid = 0;
+      r.output = -1;
+      r.status = 0;
+      runIndex[key] = runs.size();
+      runs.push_back(r);
+    }
+
+    runs[runIndex[key]].cases.push_back(cases.size());
+    cases.push_back(c);
+  }
+
+  if (cases.empty())
+  {
+    throw GoldenFramesException(filename, "No cases");
+  }
+}
+
+std::string GoldenFrames::resolve(std::string base, std::string path)
+{
+  return path[0] == '/' ? path : base + path;
+}
+
+std::string GoldenFrames::imageName(const golden_case &c)
+{
+  std::string name = stem(c.rom);
+
+  if (c.movie != GOLDEN_NO_MOVIE)
+  {
+    name += "-" + stem(c.movie);
+  }
+
+  return name + "-" + boost::lexical_cast<std::string>(c.frame);
+}
+
+int GoldenFrames::run(unsigned int jobs)
+{
+  if (jobs == 0)
+  {
+    jobs = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  if (isUpdate)
+  {
+    mkdir((directory + GOLDEN_IMAGE_DIR).c_str(), 0755);
+  }
+
+  std::cout << "Golden frames: " << cases.size() << " checkpoints in " << runs.size() << " runs, " << jobs << " at a time" << std::endl;
+
+  size_t next = 0;
+  std::map<pid_t, size_t> running;
+
+  while (next < runs.size() || !running.empty())
+  {
+    while (next < runs.size() && running.size() < jobs)
+    {
+      start(runs[next]);
+      running[runs[next].pid] = next;
+      next++;
+    }
+
+    // Results are read as they come, a run with many checkpoints would
+    // otherwise block on a full pipe. The end of one means the run is done.
+    std::vector<struct pollfd> outputs;
+    std::vector<size_t> polled;
+
+    for (std::map<pid_t, size_t>::iterator it = running.begin(); it != running.end(); ++it)
+    {
+      struct pollfd output = { runs[it->second].output, POLLIN, 0 };
+      outputs.push_back(output);
+      polled.push_back(it->second);
+    }
+
+    if (poll(outputs.data(), outputs.size(), -1) < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      throw GoldenFramesException(filename, strerror(errno));
+    }
+
+    for (size_t i = 0; i < outputs.size(); i++)
+    {
+      golden_run &r = runs[polled[i]];
+      char buffer[GOLDEN_READ_SIZE];
+
+      if (!outputs[i].revents)
+      {
+        continue;
+      }
+
+      ssize_t size = read(r.output, buffer, sizeof(buffer));
+
+      if (size > 0)
+      {
+        r.results.append(buffer, size);
+      }
+      else if (size == 0 || errno != EINTR)
+      {
+        close(r.output);
+        waitpid(r.pid, &r.status, 0);
+        running.erase(r.pid);
+        finish(r);
+      }
+    }
+  }
+
+  unsigned int passed = 0, failed = 0, missing = 0, errors = 0;
+
+  for (std::vector<golden_case>::iterator it = cases.begin(); it != cases.end(); ++it)
+  {
+    std::string name = it->rom + " " + it->movie + " " + boost::lexical_cast<std::string>(it->frame);
+
+    if (it->hash.empty())
+    {
+      std::cout << "  ERROR " << name << ": the run ended before this frame" << std::endl;
+      errors++;
+    }
+    else if (it->golden.empty())
+    {
+      std::cout << "  NEW   " << name << ": " << it->hash << std::endl;
+      missing++;
+    }
+    else if (it->hash == it->golden)
+    {
+      passed++;
+    }
+    else
+    {
+      std::cout << "  FAIL  " << name << ": expected " << it->golden << ", got " << it->hash;
+
+      if (isUpdate)
+      {
+        std::cout << ", updated";
+      }
+      else if (it->changedPixels)
+      {
+        std::cout << ", " << it->changedPixels << " pixels differ, see " << imageName(*it) << ".diff.ppm";
+      }
+      else
+      {
+        std::cout << ", see " << imageName(*it) << ".actual.ppm";
+      }
+
+      std::cout << std::endl;
+      failed++;
+    }
+  }
+
+  std::cout << "Golden frames: " << passed << " passed, " << failed << " failed, " << missing << " without a golden hash, " << errors << " not reached" << std::endl;
+
+  if (isUpdate)
+  {
+    save();
+    return errors ? 1 : 0;
+  }
+
+  return failed || missing || errors ? 1 : 0;
+}
+
+void GoldenFrames::start(golden_run &r)
+{
+  int fds[2];
+
+  if (pipe(fds) != 0)
+  {
+    throw GoldenFramesException(filename, strerror(errno));
+  }
+
+  std::cout.flush();
+  std::cerr.flush();
+  r.pid = fork();
+
+  if (r.pid < 0)
+  {
+    throw GoldenFramesException(filename, strerror(errno));
+  }
+  else if (r.pid == 0)
+  {
+    close(fds[0]);
+    runCases(r, fds[1]);
+  }
+
+  close(fds[1]);
+  r.output = fds[0];
+}
+
+// Runs in the forked process and never returns
+void GoldenFrames::runCases(golden_run &r, int output)
+{
+  // The emulator's own messages would interleave between the runs
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDOUT_FILENO);
+  FILE *results = fdopen(output, "w");
+
+  Config &config = Config::instance();
+  config.showRomInfo = false;
+  config.renderer = "null";
+  config.renderThread = false;
+  config.captureVideo = "";
+  config.stateLog = "";
+  config.stateCompare = "";
+  config.stateDumpFrame = 0;
+  config.recordMovie = "";
+  config.playMovie = r.movie;
+  config.frameLimit = 0;
+
+  Yane yane;
+
+  try
+  {
+    yane.init(r.rom);
+  }
+  catch (const YaneException &e)
+  {
+    std::cerr << "Error: " << e.what() << std::endl;
+    exit(1);
+  }
+
+  for (std::vector<size_t>::iterator it = r.cases.begin(); it != r.cases.end(); ++it)
+  {
+    const golden_case &c = cases[*it];
+    config.frameLimit = std::max(config.frameLimit, c.frame);
+
+    yane.watchFrame(c.frame, [this, &c, results](unsigned long long frame, const unsigned short *frameBuffer, const palette_entry *colors)
+    {
+      std::stringstream hash;
+      hash << std::hex << std::setfill('0') << std::setw(16) << utils::hash64((const unsigned char*)frameBuffer, GOLDEN_PIXELS * sizeof(unsigned short));
+
+      std::vector<unsigned char> pixels(GOLDEN_PIXELS * 3);
+
+      for (int i = 0; i < GOLDEN_PIXELS; i++)
+      {
+        const palette_entry &color = colors[frameBuffer[i]];
+        pixels[i * 3] = color.r;
+        pixels[i * 3 + 1] = color.g;
+        pixels[i * 3 + 2] = color.b;
+      }
+
+      std::string reference = directory + GOLDEN_IMAGE_DIR + "/" + imageName(c) + ".ppm";
+      unsigned int changedPixels = 0;
+
+      if (isUpdate)
+      {
+        writePpm(reference, pixels);
+      }
+      else if (!c.golden.empty() && hash.str() != c.golden)
+      {
+        writePpm(imageName(c) + ".actual.ppm", pixels);
+        std::vector<unsigned char> expected;
+
+        // Changed pixels in red over a dimmed reference
+        if (readPpm(reference, expected))
+        {
+          std::vector<unsigned char> diff(GOLDEN_PIXELS * 3);
+
+          for (int i = 0; i < GOLDEN_PIXELS; i++)
+          {
+            unsigned char *p = &diff[i * 3];
+
+            if (memcmp(&pixels[i * 3], &expected[i * 3], 3) != 0)
+            {
+              p[0] = 0xFF;
+              p[1] = p[2] = 0;
+              changedPixels++;
+            }
+            else
+            {
+              p[0] = p[1] = p[2] = (expected[i * 3] + expected[i * 3 + 1] + expected[i * 3 + 2]) / 12;
+            }
+          }
+
+          if (changedPixels)
+          {
+            writePpm(imageName(c) + ".diff.ppm", diff);
+          }
+        }
+      }
+
+      fprintf(results, "%llu %s %u\n", frame, hash.str().c_str(), changedPixels);
+    });
+  }
+
+  int exitCode = yane.run();
+  fclose(results);
+  exit(exitCode);
+}
+
+void GoldenFrames::finish(golden_run &r)
+{
+  std::istringstream results(r.results);
+  unsigned long long frame;
+  std::string hash;
+  unsigned int changedPixels;
+
+  while (results >> frame >> hash >> changedPixels)
+  {
+    for (std::vector<size_t>::iterator it = r.cases.begin(); it != r.cases.end(); ++it)
+    {
+      if (cases[*it].frame == frame)
+      {
+        cases[*it].hash = hash;
+        cases[*it].changedPixels = changedPixels;
+      }
+    }
+  }
+
+  if (!WIFEXITED(r.status) || WEXITSTATUS(r.status) != 0)
+  {
+    std::cerr << "Error: Run of " << r.rom << (r.movie.empty() ? "" : " with " + r.movie) << " failed" << std::endl;
+  }
+}
+
+// Rewrites the case list with the new hashes, comments are kept
+void GoldenFrames::save()
+{
+  for (std::vector<golden_case>::iterator it = cases.begin(); it != cases.end(); ++it)
+  {
+    if (!it->hash.empty())
+    {
+      lines[it->line] = it->rom + " " + it->movie + " " + boost::lexical_cast<std::string>(it->frame) + " " + it->hash;
+    }
+  }
+
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+
+  for (std::vector<std::string>::iterator it = lines.begin(); it != lines.end(); ++it)
+  {
+    file << *it << "\n";
+  }
+
+  if (file.good())
+  {
+    std::cout << "Golden hashes and images saved to " << filename << " and " << directory + GOLDEN_IMAGE_DIR << std::endl;
+  }
+  else
+  {
+    std::cerr << "Error: Unable to write " << filename << std::endl;
+  }
+}
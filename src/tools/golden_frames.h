@@ -0,0 +1,70 @@
+#ifndef _GOLDEN_FRAMES_H_
+#define _GOLDEN_FRAMES_H_
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#define GOLDEN_NO_MOVIE    "-"
+#define GOLDEN_NO_HASH     "-"
+#define GOLDEN_IMAGE_DIR   "golden"  // Reference images, next to the case list
+#define GOLDEN_READ_SIZE   4096
+
+// One checkpoint: the frame a rom reaches with the input of a movie
+typedef struct
+{
+  size_t line;  // Index into the lines of the case list
+  std::string rom;  // As written in the case list
+  std::string movie;
+  unsigned long long frame;
+  std::string golden;  // Empty when there is no golden hash yet
+  std::string hash;  // Empty when the run did not reach the frame
+  unsigned int changedPixels;  // Compared to the reference image, if there is one
+} golden_case;
+
+// Checkpoints of the same rom and movie share one run
+typedef struct
+{
+  std::string rom;  // Resolved against the rom directory
+  std::string movie;  // Resolved against the case list directory
+  std::vector<size_t> cases;
+  pid_t pid;
+  int output;
+  std::string results;  // Read from `output` as the run writes them
+  int status;
+} golden_run;
+
+// Regression check of the drawn frames. A case list has one checkpoint per
+// line, "rom movie frame hash", where the movie and hash can be "-". Roms are
+// looked up in the rom directory, which defaults to the case list's. Every
+// rom and movie pair runs headless in its own process, as many at a time as
+// there are jobs, and the frame buffer is hashed at the checkpoints. A
+// mismatch writes the frame and, when a reference image exists, a diff image
+// to the current directory. Updating stores the hashes and reference images.
+class GoldenFrames
+{
+public:
+  GoldenFrames(std::string filename, std::string romDirectory, bool isUpdate);
+
+  // Returns the exit code, 0 when every checkpoint matched
+  int run(unsigned int jobs);
+
+private:
+  std::string filename;
+  std::string directory;
+  std::string romDirectory;
+  bool isUpdate;
+  std::vector<std::string> lines;
+  std::vector<golden_case> cases;
+  std::vector<golden_run> runs;
+
+  void parse();
+  std::string resolve(std::string base, std::string path);
+  std::string imageName(const golden_case &c);
+  void start(golden_run &r);
+  void runCases(golden_run &r, int output);
+  void finish(golden_run &r);
+  void save();
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <boost/lexical_cast.hpp>
+
+#include "tools/shm_reader.h"
+#include "yane_exception.h"
+
+ShmReader::ShmReader(std::string name) :
+  name(name),
+  header(NULL),
+  mappedSize(0),
+  next(0),
+  lost(0)
+{
+  attach();
+}
+
+ShmReader::~ShmReader()
+{
+  if (header)
+  {
+    munmap(header, mappedSize);
+  }
+}
+
+// The renderer creates the object, sizes it and writes the magic last
+void ShmReader::attach()
+{
+  for (int waited = 0; waited < SHM_ATTACH_TIMEOUT_MS; waited += SHM_ATTACH_POLL_MS)
+  {
+    if (!header)
+    {
+      int fd = shm_open(name.c_str(), O_RDWR, 0);
+      struct stat status;
+
+      if (fd < 0 && errno != ENOENT)
+      {
+        throw ShmRingException(name, strerror(errno));
+      }
+
+      if (fd >= 0 && fstat(fd, &status) == 0 && (size_t)status.st_size >= sizeof(shm_frame_header))
+      {
+        void *memory = mmap(NULL, status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (memory == MAP_FAILED)
+        {
+          int error = errno;
+          close(fd);
+          throw ShmRingException(name, strerror(error));
+        }
+
+        header = (shm_frame_header*)memory;
+        mappedSize = status.st_size;
+      }
+
+      if (fd >= 0)
+      {
+        close(fd);
+      }
+    }
+
+    if (header && header->magic == SHM_FRAME_MAGIC)
+    {
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      if (header->version != SHM_FRAME_VERSION)
+      {
+        throw ShmRingException(name, "Version " + boost::lexical_cast<std::string>(header->version) + " is not supported");
+      }
+
+      // Start at the oldest frame still in the ring
+      unsigned long long published = header->published.load(std::memory_order_acquire);
+      next = published > header->slotCount ? published - header->slotCount : 0;
+      return;
+    }
+
+    usleep(SHM_ATTACH_POLL_MS * 1000);
+  }
+
+  throw ShmRingException(name, "No renderer published to it");
+}
+
+bool ShmReader::take(unsigned char *frame, bool wait, unsigned long long &number)
+{
+  while (true)
+  {
+    // Closed first, frames published before that are still taken
+    bool closed = header->closed.load();
+    unsigned long long published = header->published.load(std::memory_order_acquire);
+
+    if (next < published)
+    {
+      if (published - next > header->slotCount)
+      {
+        lost += published - header->slotCount - next;
+        next = published - header->slotCount;
+      }
+
+      number = next++;
+
+      if (readSlot(number, frame))
+      {
+        header->consumed.store(number + 1);
+        return true;
+      }
+
+      lost++;
+      continue;
+    }
+
+    if (!wait || closed)
+    {
+      return false;
+    }
+
+    sleep();
+  }
+}
+
+void ShmReader::skipToLatest()
+{
+  unsigned long long published = header->published.load(std::memory_order_acquire);
+
+  if (published > next)
+  {
+    next = published - 1;
+  }
+}
+
+// False if the frame was overwritten before or while it was copied
+bool ShmReader::readSlot(unsigned long long number, unsigned char *frame)
+{
+  unsigned char *slots = (unsigned char*)header + SHM_ALIGN_UP(sizeof(shm_frame_header));
+  shm_frame_slot *slot = (shm_frame_slot*)(slots + (number % header->slotCount) * header->slotSize);
+  unsigned long long sequence = slot->sequence.load(std::memory_order_acquire);
+
+  if (sequence != 2 * number + 2)
+  {
+    return false;
+  }
+
+  memcpy(frame, (unsigned char*)slot + SHM_FRAME_ALIGN, header->frameSize);
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  return slot->sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+// Counted in before `notify` is read, so the renderer can't miss waking us
+void ShmReader::sleep()
+{
+  header->waiters.fetch_add(1);
+  unsigned int notify = header->notify.load();
+
+  if (header->published.load() <= next && !header->closed.load())
+  {
+    syscall(SYS_futex, (int*)&header->notify, FUTEX_WAIT, notify, NULL, NULL, 0);
+  }
+
+  header->waiters.fetch_sub(1);
+}
@@ -0,0 +1,43 @@
+#ifndef _SHM_READER_H_
+#define _SHM_READER_H_
+
+#include <string>
+#include "renderers/shmrenderer.h"
+
+#define SHM_ATTACH_TIMEOUT_MS  5000  // How long to wait for the renderer to start
+#define SHM_ATTACH_POLL_MS     10
+
+// Takes the frames a ShmRenderer publishes, following the protocol described
+// in shmrenderer.h. Frames are taken in order, a reader that falls more than
+// the ring behind loses the oldest ones. The mapping is kept after the
+// renderer closes, so the last frames can still be taken.
+class ShmReader
+{
+public:
+  ShmReader(std::string name);
+  ~ShmReader();
+  const shm_frame_header &getHeader() { return *header; };
+
+  // Copies the next frame, frameSize bytes, and sets its number. Returns
+  // false if there is none yet, or when waiting, once the renderer closed.
+  bool take(unsigned char *frame, bool wait, unsigned long long &number);
+
+  // Moves on to the newest frame, for readers that only show the latest one
+  void skipToLatest();
+
+  // Frames overwritten before they could be taken, since attaching
+  unsigned long long getLost() { return lost; };
+
+private:
+  std::string name;
+  shm_frame_header *header;
+  size_t mappedSize;
+  unsigned long long next;
+  unsigned long long lost;
+
+  void attach();
+  bool readSlot(unsigned long long number, unsigned char *frame);
+  void sleep();
+};
+
+#endif
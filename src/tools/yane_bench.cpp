@@ -0,0 +1,54 @@
+#include <iostream>
+#include <stdlib.h>
+#include <SDL/SDL.h>
+#include <boost/program_options.hpp>
+
+#include "tools/benchmark.h"
+#include "yane_exception.h"
+
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+  atexit(SDL_Quit);
+
+  boost::program_options::variables_map vm;
+  boost::program_options::options_description desc("Usage: yane_bench [options]");
+  desc.add_options()
+    ("help", "Show this help message")
+    ("output,o", boost::program_options::value<string>()->default_value("yane-bench.json"), "File the results are saved to, compare two with scripts/bench_compare.py")
+  ;
+
+  try
+  {
+    boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+    boost::program_options::notify(vm);
+
+    if (vm.count("help"))
+    {
+      cout << desc << endl;
+      exit(0);
+    }
+  }
+  catch (exception& e)
+  {
+    cout << desc << endl;
+    cerr << "Error: " << e.what() << endl;
+    exit(1);
+  }
+
+  try
+  {
+    Benchmark benchmark;
+    benchmark.run();
+    benchmark.save(vm["output"].as<string>());
+  }
+  catch (const YaneException &e)
+  {
+    std::cerr << "Error: " << e.what() << std::endl;
+    exit(1);
+  }
+
+  return 0;
+}
@@ -0,0 +1,72 @@
+#include <iostream>
+#include <stdlib.h>
+#include <SDL/SDL.h>
+#include <boost/program_options.hpp>
+
+#include "tools/cpu_harness.h"
+#include "yane_exception.h"
+
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+  atexit(SDL_Quit);
+
+  boost::program_options::variables_map vm;
+  boost::program_options::options_description desc("Usage: yane_cpu_harness [options] --vectors <JSON_FILE>... | --lockstep <ROM_FILE>");
+  desc.add_options()
+    ("help", "Show this help message")
+    ("vectors", boost::program_options::value<vector<string> >()->multitoken(), "Replay single step CPU test vectors from JSON files")
+    ("lockstep", boost::program_options::value<string>(), "Run a rom on the reference CPU and --core side by side, stop at the first difference")
+    ("steps", boost::program_options::value<unsigned long long>()->default_value(HARNESS_DEFAULT_STEPS), "Instructions run by --lockstep")
+    ("core", boost::program_options::value<string>()->default_value(HARNESS_REFERENCE_CORE), "CPU implementation tested by --vectors and --lockstep")
+  ;
+
+  try
+  {
+    boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+    boost::program_options::notify(vm);
+
+    if (vm.count("help"))
+    {
+      cout << desc << endl;
+      exit(0);
+    }
+    else if (!vm.count("vectors") && !vm.count("lockstep"))
+    {
+      cout << desc << endl;
+      cerr << "Error: Neither test vectors nor a rom were specified." << endl;
+      exit(1);
+    }
+  }
+  catch (exception& e)
+  {
+    cout << desc << endl;
+    cerr << "Error: " << e.what() << endl;
+    exit(1);
+  }
+
+  try
+  {
+    CpuHarness harness(vm["core"].as<string>());
+    int exitCode = 0;
+
+    if (vm.count("vectors"))
+    {
+      exitCode |= harness.runVectors(vm["vectors"].as<vector<string> >());
+    }
+
+    if (vm.count("lockstep"))
+    {
+      exitCode |= harness.runLockstep(vm["lockstep"].as<string>(), vm["steps"].as<unsigned long long>());
+    }
+
+    return exitCode;
+  }
+  catch (const YaneException &e)
+  {
+    std::cerr << "Error: " << e.what() << std::endl;
+    exit(1);
+  }
+}
@@ -0,0 +1,77 @@
+#include <iostream>
+#include <stdlib.h>
+#include <SDL/SDL.h>
+#include <boost/program_options.hpp>
+
+#include "tools/golden_frames.h"
+#include "rom_generator.h"
+#include "yane_exception.h"
+
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+  atexit(SDL_Quit);
+
+  boost::program_options::variables_map vm;
+  boost::program_options::positional_options_description positional;
+  boost::program_options::options_description desc("Usage: yane_golden [options] <CASE_LIST>");
+  desc.add_options()
+    ("help", "Show this help message")
+    ("cases", boost::program_options::value<string>(), "Case list to check, one \"rom movie frame hash\" per line")
+    ("update", "Store the hashes and images of the cases as the new golden ones")
+    ("jobs", boost::program_options::value<unsigned int>()->default_value(0), "Cases run at a time, 0 runs one per core")
+    ("rom-dir", boost::program_options::value<string>(), "Directory the roms of the case list are in (default: the case list's)")
+    ("generate-roms", "Write the synthetic roms to --rom-dir before checking the cases")
+  ;
+  positional.add("cases", 1);
+
+  try
+  {
+    boost::program_options::store(boost::program_options::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+    boost::program_options::notify(vm);
+
+    if (vm.count("help"))
+    {
+      cout << desc << endl;
+      exit(0);
+    }
+    else if (!vm.count("cases"))
+    {
+      cout << desc << endl;
+      cerr << "Error: No case list was specified." << endl;
+      exit(1);
+    }
+    else if (vm.count("generate-roms") && !vm.count("rom-dir"))
+    {
+      cout << desc << endl;
+      cerr << "Error: --generate-roms needs --rom-dir." << endl;
+      exit(1);
+    }
+  }
+  catch (exception& e)
+  {
+    cout << desc << endl;
+    cerr << "Error: " << e.what() << endl;
+    exit(1);
+  }
+
+  try
+  {
+    std::string romDirectory = vm.count("rom-dir") ? vm["rom-dir"].as<string>() : "";
+
+    if (vm.count("generate-roms"))
+    {
+      romgen::writeCorpus(romDirectory);
+    }
+
+    GoldenFrames golden(vm["cases"].as<string>(), romDirectory, vm.count("update"));
+    return golden.run(vm["jobs"].as<unsigned int>());
+  }
+  catch (const YaneException &e)
+  {
+    std::cerr << "Error: " << e.what() << std::endl;
+    exit(1);
+  }
+}
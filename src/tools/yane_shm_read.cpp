@@ -0,0 +1,77 @@
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <boost/program_options.hpp>
+
+#include "tools/shm_reader.h"
+#include "yane_exception.h"
+
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+  boost::program_options::variables_map vm;
+  boost::program_options::options_description desc("Usage: yane_shm_read [options]");
+  desc.add_options()
+    ("help", "Show this help message")
+    ("shm-name", boost::program_options::value<string>()->default_value("/yane"), "Shared memory object the shm renderer publishes frames to")
+    ("frames", boost::program_options::value<unsigned long long>()->default_value(0), "Frames to take, 0 takes them until the renderer closes")
+    ("latest", "Only take the newest frame, as a display would")
+  ;
+
+  try
+  {
+    boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+    boost::program_options::notify(vm);
+
+    if (vm.count("help"))
+    {
+      cout << desc << endl;
+      exit(0);
+    }
+  }
+  catch (exception& e)
+  {
+    cout << desc << endl;
+    cerr << "Error: " << e.what() << endl;
+    exit(1);
+  }
+
+  try
+  {
+    ShmReader reader(vm["shm-name"].as<string>());
+    const shm_frame_header &header = reader.getHeader();
+    std::vector<unsigned char> frame(header.frameSize);
+    unsigned long long frames = vm["frames"].as<unsigned long long>();
+    unsigned long long taken = 0;
+    unsigned long long number;
+
+    cout << "Reading " << header.width << "x" << header.height << " frames from " << header.slotCount << " slots" << endl;
+
+    while (frames == 0 || taken < frames)
+    {
+      if (vm.count("latest"))
+      {
+        reader.skipToLatest();
+      }
+
+      if (!reader.take(frame.data(), true, number))
+      {
+        break;
+      }
+
+      taken++;
+    }
+
+    cout << "Took " << taken << " frames, lost " << reader.getLost() << endl;
+    cout << "The renderer published " << header.published.load() << " frames, " << header.dropped.load() << " dropped" << endl;
+  }
+  catch (const YaneException &e)
+  {
+    std::cerr << "Error: " << e.what() << std::endl;
+    exit(1);
+  }
+
+  return 0;
+}
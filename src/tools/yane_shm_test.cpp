@@ -0,0 +1,143 @@
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#include <boost/lexical_cast.hpp>
+
+#include "tools/shm_reader.h"
+#include "renderers/shmrenderer.h"
+#include "frame_converter.h"
+#include "config.h"
+#include "yane_exception.h"
+
+#define SHM_TEST_SLOTS  4
+
+
+using namespace std;
+
+static std::string name;
+static palette_entry colors[PALETTE_TABLE_SIZE];
+
+static void check(bool condition, std::string error)
+{
+  if (!condition)
+  {
+    throw ShmRingException(name, error);
+  }
+}
+
+// Frame n has every index shifted by n, so each frame converts differently
+static void makeFrame(unsigned long long number, std::vector<unsigned short> &frame)
+{
+  for (size_t i = 0; i < frame.size(); i++)
+  {
+    frame[i] = (i + number) % PALETTE_TABLE_SIZE;
+  }
+}
+
+static void publish(ShmRenderer &renderer, unsigned long long &published, int count)
+{
+  std::vector<unsigned short> frame(SCREEN_WIDTH * SCREEN_HEIGHT);
+
+  for (int n = 0; n < count; n++, published++)
+  {
+    makeFrame(published, frame);
+    renderer.update(frame.data());
+  }
+}
+
+static void expectFrame(ShmReader &reader, FrameConverter &converter, unsigned long long expected)
+{
+  std::vector<unsigned char> frame(reader.getHeader().frameSize);
+  std::vector<unsigned char> converted(converter.getFrameSize());
+  std::vector<unsigned short> indices(SCREEN_WIDTH * SCREEN_HEIGHT);
+  unsigned long long number;
+
+  check(reader.take(frame.data(), false, number), "Frame " + boost::lexical_cast<std::string>(expected) + " was not published");
+  check(number == expected, "Took frame " + boost::lexical_cast<std::string>(number) + ", expected " + boost::lexical_cast<std::string>(expected));
+
+  makeFrame(number, indices);
+  converter.convert(indices.data(), converted.data());
+  check(frame == converted, "Frame " + boost::lexical_cast<std::string>(number) + " has the wrong pixels");
+}
+
+static void expectDropped(ShmReader &reader, unsigned long long dropped)
+{
+  check(reader.getHeader().dropped.load() == dropped, "The renderer counted " + boost::lexical_cast<std::string>(reader.getHeader().dropped.load()) + " dropped frames, expected " + boost::lexical_cast<std::string>(dropped));
+  check(reader.getLost() == dropped, "The reader lost " + boost::lexical_cast<std::string>(reader.getLost()) + " frames, expected " + boost::lexical_cast<std::string>(dropped));
+}
+
+// Publishes and takes frames in a fixed order, one process, and checks the
+// frame numbers, pixels and drop counts of the ring
+int main()
+{
+  name = "/yane-shm-test-" + boost::lexical_cast<std::string>(getpid());
+
+  for (int i = 0; i < PALETTE_TABLE_SIZE; i++)
+  {
+    palette_entry color = { (unsigned char)i, (unsigned char)(i * 3), (unsigned char)(i * 7) };
+    colors[i] = color;
+  }
+
+  Config &config = Config::instance();
+  config.shmName = name;
+  config.shmSlots = SHM_TEST_SLOTS;
+  config.shmFormat = PixelFormat::XRGB8888;
+
+  try
+  {
+    overscan_crop crop = { config.overscanTop, config.overscanBottom, config.overscanLeft, config.overscanRight };
+    FrameConverter converter(colors, config.shmFormat, crop);
+    ShmRenderer renderer;
+    unsigned long long published = 0;
+    unsigned long long number;
+
+    renderer.setColors(colors);
+    renderer.init();
+    ShmReader reader(name);
+
+    // A reader that keeps up takes every frame
+    publish(renderer, published, 1);
+    expectFrame(reader, converter, 0);
+    publish(renderer, published, 2);
+    expectFrame(reader, converter, 1);
+    expectFrame(reader, converter, 2);
+    expectDropped(reader, 0);
+
+    // Falling 6 frames behind a ring of 4 loses frames 3 and 4
+    publish(renderer, published, 6);
+
+    for (unsigned long long n = 5; n < 9; n++)
+    {
+      expectFrame(reader, converter, n);
+    }
+
+    expectDropped(reader, 2);
+
+    // Skipping to the newest frame drops nothing, even once the frames it
+    // skipped over are overwritten
+    publish(renderer, published, 3);
+    reader.skipToLatest();
+    expectFrame(reader, converter, 11);
+    publish(renderer, published, SHM_TEST_SLOTS);
+    expectDropped(reader, 2);
+
+    for (unsigned long long n = 12; n < 16; n++)
+    {
+      expectFrame(reader, converter, n);
+    }
+
+    // The reader keeps its mapping once the renderer is gone
+    renderer.cleanup();
+    check(!reader.take(std::vector<unsigned char>(reader.getHeader().frameSize).data(), true, number), "Took a frame after the renderer closed");
+    check(reader.getHeader().published.load() == published, "Published count is wrong");
+  }
+  catch (const YaneException &e)
+  {
+    std::cerr << "Error: " << e.what() << std::endl;
+    exit(1);
+  }
+
+  std::cout << "Shared memory ring: frame order and drop counts are right" << std::endl;
+  return 0;
+}
@@ -1,5 +1,12 @@
+#include <string.h>
 #include "utils.h"
 
+#define XXH_PRIME1  0x9E3779B185EBCA87ULL
+#define XXH_PRIME2  0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME3  0x165667B19E3779F9ULL
+#define XXH_PRIME4  0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME5  0x27D4EB2F165667C5ULL
+
 namespace utils
 {
   timespec timespecDiff(timespec *start, timespec *end)
@@ -19,4 +26,86 @@ namespace utils
 
     return temp;
   }
+
+  static inline unsigned long long rotl64(unsigned long long value, int bits)
+  {
+    return (value << bits) | (value >> (64 - bits));
+  }
+
+  static inline unsigned long long read64(const unsigned char *data)
+  {
+    unsigned long long value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+  }
+
+  static inline unsigned long long xxhRound(unsigned long long accumulator, unsigned long long input)
+  {
+    return rotl64(accumulator + input * XXH_PRIME2, 31) * XXH_PRIME1;
+  }
+
+  static inline unsigned long long xxhMerge(unsigned long long hash, unsigned long long accumulator)
+  {
+    return (hash ^ xxhRound(0, accumulator)) * XXH_PRIME1 + XXH_PRIME4;
+  }
+
+  // XXH64. The four independent lanes keep the multipliers busy, and the
+  // compiler can vectorize them. Input words are read little endian, as on
+  // the hosts yane runs on.
+  unsigned long long hash64(const unsigned char *data, size_t length, unsigned long long seed)
+  {
+    const unsigned char *end = data + length;
+    unsigned long long hash;
+
+    if (length >= 32)
+    {
+      unsigned long long lanes[4] = { seed + XXH_PRIME1 + XXH_PRIME2, seed + XXH_PRIME2, seed, seed - XXH_PRIME1 };
+
+      for (; data + 32 <= end; data += 32)
+      {
+        for (int i = 0; i < 4; i++)
+        {
+          lanes[i] = xxhRound(lanes[i], read64(data + i * 8));
+        }
+      }
+
+      hash = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+
+      for (int i = 0; i < 4; i++)
+      {
+        hash = xxhMerge(hash, lanes[i]);
+      }
+    }
+    else
+    {
+      hash = seed + XXH_PRIME5;
+    }
+
+    hash += length;
+
+    for (; data + 8 <= end; data += 8)
+    {
+      hash = rotl64(hash ^ xxhRound(0, read64(data)), 27) * XXH_PRIME1 + XXH_PRIME4;
+    }
+
+    if (data + 4 <= end)
+    {
+      unsigned int word;
+      memcpy(&word, data, sizeof(word));
+      hash = rotl64(hash ^ (word * XXH_PRIME1), 23) * XXH_PRIME2 + XXH_PRIME3;
+      data += 4;
+    }
+
+    for (; data < end; data++)
+    {
+      hash = rotl64(hash ^ (*data * XXH_PRIME5), 11) * XXH_PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+  }
 }
@@ -2,10 +2,12 @@
 #define _UTILS_H_
 
 #include <ctime>
+#include <cstddef>
 
 namespace utils
 {
   timespec timespecDiff(timespec *start, timespec *end);
+  unsigned long long hash64(const unsigned char *data, size_t length, unsigned long long seed = 0);
 }
 
 #endif
@@ -9,6 +9,9 @@
 #include "cpu.h"
 #include "ppu.h"
 #include "controller.h"
+#include "scheduler.h"
+#include "state_log.h"
+#include "movie.h"
 #include "yane_exception.h"
 #include "config.h"
 #include "ines.h"
@@ -18,17 +21,28 @@
 Yane::Yane()
 :
   isRunning(false),
-  isReset(false)
+  isReset(false),
+  exitCode(0),
+  lastFrame(0),
+  movieFrame(0),
+  frameStats(frame_stats())
 {
   _cpu = boost::make_shared<cpu>();
   _ppu = boost::make_shared<ppu>();
   _controller = boost::make_shared<Controller>(this);
+  _scheduler = boost::make_shared<Scheduler>();
 }
 
 Yane::~Yane()
 {}
 
 void Yane::init(std::string filename)
+{
+  init(filename, boost::shared_ptr<Renderer>());
+}
+
+// Draws to the given renderer, or the configured one when it is null
+void Yane::init(std::string filename, boost::shared_ptr<Renderer> renderer)
 {
   // Initialize rom
   _rom = boost::make_shared<iNes>(filename);
@@ -42,8 +56,8 @@ void Yane::init(std::string filename)
   // Initialize cartridge, cpu and ppu
   try
   {
-    _mapper = CartridgeFactory::create(_rom, _cpu);
-    _renderer = RendererFactory::create(Config::instance().renderer);
+    _mapper = CartridgeFactory::create(_rom, _cpu, _ppu, _scheduler);
+    _renderer = renderer ? renderer : RendererFactory::create(Config::instance().renderer);
 
     // Display rom headers and exit
     if (Config::instance().showRomInfo)
@@ -52,8 +66,31 @@ void Yane::init(std::string filename)
       exit(0);
     }
 
-    _cpu->init(_mapper, _ppu);
-    _ppu->init(_mapper, _renderer, _cpu);
+    _cpu->init(_mapper, _ppu, _scheduler);
+    _ppu->init(_mapper, _renderer, _cpu, _scheduler);
+
+    if (!Config::instance().stateLog.empty())
+    {
+      _stateLog = boost::make_shared<StateLog>(Config::instance().stateLog, StateLogMode::WriteHashes);
+    }
+    else if (!Config::instance().stateCompare.empty())
+    {
+      _stateLog = boost::make_shared<StateLog>(Config::instance().stateCompare, StateLogMode::CompareHashes);
+    }
+
+    if (!Config::instance().statsFile.empty())
+    {
+      _statsDump = boost::make_shared<StatsDump>(Config::instance().statsFile, Config::instance().statsInterval);
+    }
+
+    if (!Config::instance().recordMovie.empty())
+    {
+      _movie = boost::make_shared<Movie>(Config::instance().recordMovie, MovieMode::RecordMovie, _rom->getDataHash());
+    }
+    else if (!Config::instance().playMovie.empty())
+    {
+      _movie = boost::make_shared<Movie>(Config::instance().playMovie, MovieMode::PlayMovie, _rom->getDataHash());
+    }
   }
   catch (YaneException e)
   {
@@ -77,15 +114,145 @@ void Yane::handleUserInput(SDL_Event event)
   _cpu->updateControllerKeyStatus(event);
 }
 
-void Yane::run()
+// Frames are counted like --frames, the first one only has the vblank lines
+// after power on
+void Yane::watchFrame(unsigned long long frame, frame_handler handler)
+{
+  _ppu->requestFrame(frame);
+  frameHandlers[frame] = handler;
+}
+
+void Yane::saveState()
+{
+  _cpu->saveState(state);
+  _ppu->saveState(state);
+  _mapper->saveState(state);
+}
+
+void Yane::resetSystem()
+{
+  _ppu->reset();
+  _cpu->reset();
+  isReset = false;
+}
+
+// Movies keep resets between frames so they happen at the same point on
+// playback
+void Yane::startMovieFrame()
+{
+  if (_movie->getMode() == MovieMode::RecordMovie)
+  {
+    movieInput.flags = isReset ? MOVIE_RESET : 0;
+
+    if (isReset)
+    {
+      resetSystem();
+    }
+
+    return;
+  }
+
+  const movie_frame *frame = _movie->getFrame(movieFrame++);
+  isReset = false;
+
+  if (!frame)
+  {
+    std::cout << "Movie ended after " << _movie->getFrameCount() << " frames" << std::endl;
+    isRunning = false;
+    return;
+  }
+
+  if (frame->flags & MOVIE_RESET)
+  {
+    resetSystem();
+  }
+
+  for (int port = 0; port < CONTROLLER_PORTS; port++)
+  {
+    _cpu->setInput(port, frame->buttons[port]);
+  }
+}
+
+// Runs at the first instruction boundary after the PPU finished a frame
+void Yane::endFrame()
+{
+  Config &config = Config::instance();
+  lastFrame = _ppu->getFrameCount();
+  frameStats = stats::endFrame(lastFrame);
+
+  if (_statsDump)
+  {
+    _statsDump->update(frameStats);
+  }
+
+  if (_stateLog || lastFrame == config.stateDumpFrame)
+  {
+    saveState();
+  }
+
+  if (_stateLog && !_stateLog->update(lastFrame, state))
+  {
+    if (_stateLog->hasDiverged())
+    {
+      StateLog::dump("state-" + boost::lexical_cast<std::string>(lastFrame) + ".diverged.dump", lastFrame, state);
+      std::cout << "Dump the state of the reference build with --state-dump " << lastFrame << " to compare" << std::endl;
+      exitCode = 1;
+    }
+
+    isRunning = false;
+  }
+
+  if (lastFrame == config.stateDumpFrame)
+  {
+    StateLog::dump("state-" + boost::lexical_cast<std::string>(lastFrame) + ".dump", lastFrame, state);
+  }
+
+  if (_movie && _movie->getMode() == MovieMode::RecordMovie)
+  {
+    for (int port = 0; port < CONTROLLER_PORTS; port++)
+    {
+      movieInput.buttons[port] = _cpu->getInput(port);
+    }
+
+    _movie->record(movieInput);
+  }
+
+  std::map<unsigned long long, frame_handler>::iterator handler = frameHandlers.find(lastFrame);
+
+  if (handler != frameHandlers.end())
+  {
+    _ppu->waitForFrame();
+    handler->second(lastFrame, _ppu->getFrameBuffer(), _ppu->getColorTable());
+  }
+
+  _cpu->nextInputFrame();
+
+  if (_movie)
+  {
+    startMovieFrame();
+  }
+
+  if (config.frameLimit && lastFrame >= config.frameLimit)
+  {
+    isRunning = false;
+  }
+}
+
+int Yane::run()
 {
   isRunning = true;
+  stats::current = frame_stats();
 
   // Start emulate components
   _ppu->start();
   _cpu->start();
   _controller->start();
 
+  if (_movie)
+  {
+    startMovieFrame();
+  }
+
   while (isRunning)
   {
     // Check status of a blargh test?
@@ -94,23 +261,34 @@ void Yane::run()
       isRunning = false;
       break;
     }
-    else if (isReset)
+    else if (isReset && !_movie)
     {
-      _ppu->reset();
-      _cpu->reset();
-      isReset = false;
+      resetSystem();
     }
 
     // Execute instruction
     try
     {
       unsigned short cycles = _cpu->executeOpcode();
-      _ppu->execute(cycles);
+      _ppu->log();
+      _scheduler->advance(cycles);
+
+      if (_ppu->getFrameCount() != lastFrame)
+      {
+        endFrame();
+      }
     }
     catch (InvalidOpcodeException e)
     {
       std::cerr << "Error: " << e.what() << std::endl;
       isRunning = false;
+      exitCode = 1;
+    }
+    catch (const StateLogException &e)
+    {
+      std::cerr << "Error: " << e.what() << std::endl;
+      isRunning = false;
+      exitCode = 1;
     }
   }
 
@@ -119,4 +297,12 @@ void Yane::run()
   _controller->stop();
   _cpu->stop();
   _ppu->stop();
+
+  if (_movie && _movie->getMode() == MovieMode::RecordMovie)
+  {
+    _movie->close();
+    std::cout << "Movie: " << _movie->getFrameCount() << " frames recorded to " << Config::instance().recordMovie << std::endl;
+  }
+
+  return exitCode;
 }
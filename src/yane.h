@@ -2,9 +2,15 @@
 #define _YANE_H_
 
 #include <string>
+#include <map>
+#include <functional>
 #include <boost/make_shared.hpp>
 #include <boost/assert.hpp>
 #include <SDL/SDL.h>
+#include "machine_state.h"
+#include "movie.h"
+#include "ppu.h"
+#include "stats.h"
 
 class Cartridge;
 class Renderer;
@@ -12,7 +18,12 @@ class iNes;
 class cpu;
 class ppu;
 class Controller;
+class Scheduler;
+class StateLog;
+class Movie;
 
+// Called with a finished frame and the colors of its indices
+typedef std::function<void(unsigned long long frame, const unsigned short *frameBuffer, const palette_entry *colors)> frame_handler;
 
 class Yane
 {
@@ -20,10 +31,15 @@ public:
   Yane();
   ~Yane();
   void init(std::string filename);
-  void run();
+  void init(std::string filename, boost::shared_ptr<Renderer> renderer);
+  int run();
   void stop();
   void reset();
   void handleUserInput(SDL_Event event);
+  void watchFrame(unsigned long long frame, frame_handler handler);
+
+  // Counters of the last finished frame, all zero unless built with YANE_STATS
+  const frame_stats &getFrameStats() { return frameStats; };
 
 private:
   boost::shared_ptr<Cartridge> _mapper;
@@ -32,8 +48,26 @@ private:
   boost::shared_ptr<cpu> _cpu;
   boost::shared_ptr<ppu> _ppu;
   boost::shared_ptr<Controller> _controller;
-  bool isRunning;
+  boost::shared_ptr<Scheduler> _scheduler;
+  boost::shared_ptr<StateLog> _stateLog;
+  boost::shared_ptr<StatsDump> _statsDump;
+  boost::shared_ptr<Movie> _movie;
+  volatile bool isRunning;  // Also cleared from signal handlers
   bool isReset;
+  int exitCode;
+  unsigned long long lastFrame;
+  machine_state state;
+  size_t movieFrame;
+  movie_frame movieInput;
+  std::map<unsigned long long, frame_handler> frameHandlers;
+  frame_stats frameStats;
+
+  void endFrame();
+  void saveState();
+  void resetSystem();
+  void startMovieFrame();
+
+  friend class Benchmark;
 };
 
 #endif
@@ -74,4 +74,74 @@ public:
     YaneException("Renderer not supported: " + name) {}
 };
 
+class SharedMemoryException : public YaneException
+{
+public:
+  SharedMemoryException(string name, string error) :
+    YaneException("Unable to set up shared memory " + name + ": " + error) {}
+};
+
+class ShmRingException : public YaneException
+{
+public:
+  ShmRingException(string name, string error) :
+    YaneException("Shared memory ring " + name + ": " + error) {}
+};
+
+class CaptureException : public YaneException
+{
+public:
+  CaptureException(string filename, string error) :
+    YaneException("Unable to open capture file " + filename + ": " + error) {}
+};
+
+class StateLogException : public YaneException
+{
+public:
+  StateLogException(string filename, string error) :
+    YaneException("State log " + filename + ": " + error) {}
+};
+
+class MovieException : public YaneException
+{
+public:
+  MovieException(string filename, string error) :
+    YaneException("Movie " + filename + ": " + error) {}
+};
+
+class GoldenFramesException : public YaneException
+{
+public:
+  GoldenFramesException(string filename, string error) :
+    YaneException("Golden frames " + filename + ": " + error) {}
+};
+
+class RomGeneratorException : public YaneException
+{
+public:
+  RomGeneratorException(string filename, string error) :
+    YaneException("Unable to generate rom " + filename + ": " + error) {}
+};
+
+class BenchmarkException : public YaneException
+{
+public:
+  BenchmarkException(string filename, string error) :
+    YaneException("Benchmark " + filename + ": " + error) {}
+};
+
+class StatsException : public YaneException
+{
+public:
+  StatsException(string filename, string error) :
+    YaneException("Unable to write statistics to " + filename + ": " + error) {}
+};
+
+class CpuHarnessException : public YaneException
+{
+public:
+  CpuHarnessException(string source, string error) :
+    YaneException("CPU harness " + source + ": " + error) {}
+};
+
 #endif